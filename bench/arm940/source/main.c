@@ -0,0 +1,77 @@
+#include <orcus.h>
+#include <malloc.h>
+#include <bench.h>
+
+/*
+  ARM940T half of the benchmark. Mailbox messages are answered from the interrupt handler, and the ring is drained
+  from the main loop so the ARM920T can measure the ring without the mailbox in the way. Last of all the main loop
+  is handed over to the job worker. The data cache is left off,
+  which the mailbox and ring both allow.
+*/
+static volatile uint32_t ringWanted = 0;
+static volatile uint32_t counted = 0;
+static volatile bool jobsWanted = false;
+static RingBuffer ring;
+
+static void count(uint32_t total, uint32_t arg1, uint32_t arg2) {
+  if(++counted == total) {
+    mailboxPost(BENCH_COUNTED, counted, 0, 0);
+    counted = 0;
+  }
+}
+
+static void echo(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+  mailboxPost(BENCH_ECHO, arg0, 0, 0);
+}
+
+static void jobsStart(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+  jobsWanted = true;
+}
+
+// nothing to do, so only the cost of getting a job here and back is measured
+static void emptyJob(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+}
+
+static void ringStart(uint32_t entries, uint32_t arg1, uint32_t arg2) {
+  ringWanted = entries;
+}
+
+int main() {
+  gp2xInit();
+  irqInit();
+
+  mailboxSetHandler(BENCH_RING_START, ringStart);
+  mailboxSetHandler(BENCH_COUNT, count);
+  mailboxSetHandler(BENCH_ECHO, echo);
+  mailboxSetHandler(BENCH_JOBS_START, jobsStart);
+  if(mailboxInit()) {
+    return 1;
+  }
+
+  void* memory = memalign(32, ringMemorySize(sizeof(uint32_t), BENCH_RING_ENTRIES));
+  if(memory == NULL || ringInit(&ring, memory, sizeof(uint32_t), BENCH_RING_ENTRIES)) {
+    return 1;
+  }
+  while(mailboxPost(BENCH_RING_READY, (uint32_t)memory, 0, 0));
+
+  uint32_t entries[32];
+  uint32_t sum = 0;
+  while(!jobsWanted) {
+    uint32_t wanted = ringWanted;
+    if(wanted == 0) {
+      continue;
+    }
+    for(uint32_t done = 0 ; done < wanted ; ) {
+      int n = ringRead(&ring, entries, 32);
+      for(int i = 0 ; i < n ; i++) {
+	sum += entries[i];
+      }
+      done += n;
+    }
+    ringWanted = 0;
+    while(mailboxPost(BENCH_RING_DONE, sum, 0, 0));
+  }
+
+  jobRegister(BENCH_JOB_EMPTY, emptyJob);
+  return jobWorker();
+}
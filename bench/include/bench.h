@@ -0,0 +1,28 @@
+#ifndef __ORCUS_BENCH_H__
+#define __ORCUS_BENCH_H__
+
+/*
+  Mailbox message types shared by the two halves of the benchmark.
+
+  ARM920T -> ARM940T
+  BENCH_RING_START - read arg0 entries from the ring, then send BENCH_RING_DONE
+  BENCH_COUNT - counted, the count is sent back with BENCH_COUNTED once it reaches arg0
+  BENCH_ECHO - sent straight back
+  BENCH_JOBS_START - stop serving the ring and become a job worker, with BENCH_JOB_EMPTY registered
+
+  ARM940T -> ARM920T
+  BENCH_RING_READY - the ring has been created, arg0 is its memory (ARM940T address, the ARM920T imports it)
+*/
+#define BENCH_RING_START 0
+#define BENCH_RING_DONE 1
+#define BENCH_RING_READY 2
+#define BENCH_COUNT 3
+#define BENCH_COUNTED 4
+#define BENCH_ECHO 5
+#define BENCH_JOBS_START 6
+
+#define BENCH_JOB_EMPTY 0
+
+#define BENCH_RING_ENTRIES 256
+
+#endif
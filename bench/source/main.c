@@ -0,0 +1,592 @@
+#include <orcus.h>
+#include <malloc.h>
+#include <string.h>
+#include <stdlib.h>
+#include <bench.h>
+#include "bench940_bin.h"
+
+/*
+  Rough numbers for the parts of the library meant to be fast, printed over the UART at 115200/8N1. Each one is
+  timed with the hardware timer over enough iterations for the 0.135us tick not to matter.
+
+  There is no build for this in the tree. Build it as an ordinary GP2X program linked against liborcus, with
+  ../arm940/source/main.c built as an ARM940T program for memory bank 1 and its binary turned into bench940_bin.h
+  with bin2o.
+
+  - ring: entries per second from the ARM920T to the ARM940T
+  - mixer: ARM920T cycles per output frame with every voice playing, at and away from the output rate
+  - mailbox: messages per second from the ARM920T to the ARM940T, and the round trip
+  - sprites: how many 16x16 sprites rgbListSprites() draws in a 60Hz frame
+  - tile map: a full screen layer scrolled one pixel per frame, and redrawn from scratch for comparison
+  - sd: read MB/s with the CPU copying the FIFO a word and a byte at a time and with DMA, and write MB/s
+  - resampler: stereo output frames per MHz of CPU clock, up, down and near 1:1
+  - jobs: dispatch overhead per empty job run on the ARM940T, one at a time and batched
+  - dma handoff: cache maintenance and DMA for a small buffer, by range and by whole cache
+  - lockdown: a lookup table loop under cache pressure, with and without the table locked in the data cache
+  - blits: 16x16 blits per 60Hz frame and CPU idle time, synchronous and from a raster list
+  - blit setup: per-blit register setup for tile map blits, with and without the register shadow
+*/
+#define CPU_MHZ 200
+#define FRAME_NS 16666667
+#define SCREEN_W 320
+#define SCREEN_H 240
+
+static Graphic screen;
+
+static uint64_t bench_perSecond(uint32_t count, unsigned long ns) {
+  return ns == 0 ? 0 : ((uint64_t)count * 1000000000) / ns;
+}
+
+static volatile bool ringDone = false;
+static void* volatile ringMemory = NULL;
+
+static void bench_ringDone(uint32_t sum, uint32_t arg1, uint32_t arg2) {
+  ringDone = true;
+}
+
+static void bench_ringReady(uint32_t memory, uint32_t arg1, uint32_t arg2) {
+  ringMemory = importPointer(memory);
+}
+
+static volatile uint32_t counted = 0;
+static volatile uint32_t echoed = 0;
+
+static void bench_counted(uint32_t count, uint32_t arg1, uint32_t arg2) {
+  counted = count;
+}
+
+static void bench_echoed(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+  echoed = arg0;
+}
+
+static bool bench_start940() {
+  mailboxSetHandler(BENCH_RING_DONE, bench_ringDone);
+  mailboxSetHandler(BENCH_RING_READY, bench_ringReady);
+  mailboxSetHandler(BENCH_COUNTED, bench_counted);
+  mailboxSetHandler(BENCH_ECHO, bench_echoed);
+
+  if(arm940Init(1)) {
+    return false;
+  }
+  memcpy((void*)0x1000000, bench940_bin, bench940_bin_size);
+  arm940Run();
+  return mailboxConnect(1000000000) == 0;
+}
+
+static void bench_ring() {
+  enum { ENTRIES = 200000, BATCH = 32 };
+  while(ringMemory == NULL);
+  RingBuffer ring;
+  ringAttach(&ring, ringMemory);
+
+  uint32_t entries[BATCH];
+  for(int i = 0 ; i < BATCH ; i++) {
+    entries[i] = i;
+  }
+
+  ringDone = false;
+  mailboxPost(BENCH_RING_START, ENTRIES, 0, 0);
+  uint32_t start = timerGet();
+  for(int written = 0 ; written < ENTRIES ; ) {
+    int count = ENTRIES - written < BATCH ? ENTRIES - written : BATCH;
+    written += ringWrite(&ring, entries, count);
+  }
+  while(!ringDone);
+  unsigned long ns = timerNsSince(start, NULL);
+  uartPrintf("ring: %lu entries per second\n", (unsigned long)bench_perSecond(ENTRIES, ns));
+}
+
+static void bench_mixer() {
+  enum { SAMPLES = 4096, BUFFER_BYTES = 4096, RENDERS = 200 };
+  int16_t* sample = malloc(SAMPLES*2);
+  uint32_t* buffer = malloc(BUFFER_BYTES);
+  if(sample == NULL || buffer == NULL) {
+    uartPrintf("mixer: out of memory\n");
+    return;
+  }
+  for(int i = 0 ; i < SAMPLES ; i++) {
+    sample[i] = rand();
+  }
+
+  mixerSetOutputRate(44100);
+  for(int resampled = 0 ; resampled < 2 ; resampled++) {
+    for(int voice = 0 ; voice < MIXER_VOICES ; voice++) {
+      mixerPlay(voice, sample, SAMPLES, MIXER_PCM16, true);
+      mixerSetVolume(voice, MIXER_UNITY/4, voice*256/MIXER_VOICES);
+      mixerSetRate(voice, resampled ? 22050 + voice*1000 : 44100);
+    }
+
+    uint32_t start = timerGet();
+    for(int i = 0 ; i < RENDERS ; i++) {
+      mixerRender(buffer, BUFFER_BYTES);
+    }
+    unsigned long ns = timerNsSince(start, NULL);
+    uint32_t frames = RENDERS*BUFFER_BYTES/4;
+    uartPrintf("mixer %d voices %s: %lu cycles per frame\n", MIXER_VOICES, resampled ? "resampled" : "at output rate",
+	       (unsigned long)(((uint64_t)ns*CPU_MHZ)/1000/frames));
+  }
+
+  for(int voice = 0 ; voice < MIXER_VOICES ; voice++) {
+    mixerStop(voice);
+  }
+  free(buffer);
+  free(sample);
+}
+
+static void bench_mailbox() {
+  enum { MESSAGES = 20000, ROUND_TRIPS = 2000 };
+
+  uint32_t start = timerGet();
+  for(int i = 0 ; i < MESSAGES ; i++) {
+    while(mailboxPost(BENCH_COUNT, MESSAGES, 0, 0));
+  }
+  while(counted != MESSAGES);
+  unsigned long ns = timerNsSince(start, NULL);
+  uartPrintf("mailbox: %lu messages per second\n", (unsigned long)bench_perSecond(MESSAGES, ns));
+
+  start = timerGet();
+  for(uint32_t i = 1 ; i <= ROUND_TRIPS ; i++) {
+    while(mailboxPost(BENCH_ECHO, i, 0, 0));
+    while(echoed != i);
+  }
+  ns = timerNsSince(start, NULL);
+  uartPrintf("mailbox: %lu ns round trip\n", ns/ROUND_TRIPS);
+}
+
+static void bench_sprites() {
+  enum { SPRITE_W = 16, SPRITE_H = 16, SPRITES = 1024, BATCHES = 20 };
+  uint16_t* pixels = memalign(32, SPRITE_W*SPRITE_H*2);
+  Sprite* sprites = malloc(SPRITES*sizeof(Sprite));
+  RasterList list;
+  if(pixels == NULL || sprites == NULL || rgbListInit(&list, SPRITES)) {
+    uartPrintf("sprites: out of memory\n");
+    return;
+  }
+  for(int i = 0 ; i < SPRITE_W*SPRITE_H ; i++) {
+    pixels[i] = (i % SPRITE_W == 0 || i % SPRITE_W == SPRITE_W - 1) ? 0 : rand();
+  }
+  Graphic src = { pixels, SPRITE_W, SPRITE_H, RGB565 };
+  rgbSetTransparencyColour(0);
+  for(int i = 0 ; i < SPRITES ; i++) {
+    // some sprites hang off the edges so the clipping is included
+    sprites[i] = (Sprite){ &src, {0, 0, SPRITE_W, SPRITE_H}, rand() % (SCREEN_W + SPRITE_W) - SPRITE_W,
+			   rand() % (SCREEN_H + SPRITE_H) - SPRITE_H, true };
+  }
+
+  uint32_t start = timerGet();
+  for(int i = 0 ; i < BATCHES ; i++) {
+    rgbListClear(&list);
+    rgbListSprites(&list, sprites, SPRITES, &screen, NULL);
+    rgbListSubmit(&list);
+    rgbListWait(&list);
+  }
+  unsigned long ns = timerNsSince(start, NULL);
+  uartPrintf("sprites: %lu %dx%d sprites per 60Hz frame\n",
+	     (unsigned long)(((uint64_t)SPRITES*BATCHES*FRAME_NS)/ns), SPRITE_W, SPRITE_H);
+
+  rgbListFree(&list);
+  free(sprites);
+  free(pixels);
+}
+
+static void bench_tileMap() {
+  enum { TILE_W = 16, TILE_H = 16, SET_COLS = 8, SET_ROWS = 4, MAP_W = 128, MAP_H = 64, FRAMES = 600 };
+  uint16_t* pixels = memalign(32, SET_COLS*TILE_W*SET_ROWS*TILE_H*2);
+  uint16_t* tiles = malloc(MAP_W*MAP_H*2);
+  if(pixels == NULL || tiles == NULL) {
+    uartPrintf("tile map: out of memory\n");
+    return;
+  }
+  for(int i = 0 ; i < SET_COLS*TILE_W*SET_ROWS*TILE_H ; i++) {
+    pixels[i] = rand();
+  }
+  for(int i = 0 ; i < MAP_W*MAP_H ; i++) {
+    tiles[i] = rand() % (SET_COLS*SET_ROWS);
+  }
+  Graphic tileset = { pixels, SET_COLS*TILE_W, SET_ROWS*TILE_H, RGB565 };
+
+  TileMap map;
+  if(tileMapInit(&map, &tileset, TILE_W, TILE_H, tiles, MAP_W, MAP_H, SCREEN_W, SCREEN_H)) {
+    uartPrintf("tile map: init failed\n");
+    return;
+  }
+
+  // scrolled only draws the tiles coming into view, redrawn draws them all every frame as a plain tile loop would
+  for(int redraw = 0 ; redraw < 2 ; redraw++) {
+    uint32_t start = timerGet();
+    for(int frame = 0 ; frame < FRAMES ; frame++) {
+      if(redraw) {
+	tileMapInvalidate(&map);
+      }
+      tileMapScroll(&map, frame, frame/2);
+      tileMapDraw(&map, &screen, 0, 0);
+      tileMapWait(&map);
+    }
+    unsigned long ns = timerNsSince(start, NULL);
+    uartPrintf("tile map %s: %lu us per frame\n", redraw ? "redrawn" : "scrolled", ns/FRAMES/1000);
+  }
+
+  tileMapFree(&map);
+  free(tiles);
+  free(pixels);
+}
+
+#define BENCH_SD_DMA 4
+#define BENCH_SD_START 8192 // clear of the partition table and the start of the first partition
+#define BENCH_SD_BLOCKS 2048
+
+// 0 ns means the transfer failed
+static void bench_sdPrint(const char* what, unsigned long ns) {
+  if(ns == 0) {
+    uartPrintf("sd %s: failed\n", what);
+    return;
+  }
+  unsigned long kbPerSecond = ((uint64_t)BENCH_SD_BLOCKS*512*1000000) / ns;
+  uartPrintf("sd %s: %lu.%03lu MB/s\n", what, kbPerSecond/1000, kbPerSecond%1000);
+}
+
+static unsigned long bench_sdRead(uint8_t* buffer) {
+  uint32_t start = timerGet();
+  if(sdReadBlocks(BENCH_SD_START, BENCH_SD_BLOCKS, buffer)) {
+    return 0;
+  }
+  return timerNsSince(start, NULL);
+}
+
+// writes put back what was just read, so the card is left as it was
+static void bench_sd() {
+  uint8_t* buffer = memalign(32, BENCH_SD_BLOCKS*512 + 4);
+  if(buffer == NULL) {
+    uartPrintf("sd: out of memory\n");
+    return;
+  }
+  if(sdInit()) {
+    uartPrintf("sd: no card\n");
+    free(buffer);
+    return;
+  }
+  uartPrintf("sd: %d-bit bus, %d kHz\n", sdBusWidth(), sdClockSpeed()/1000);
+
+  sdSetDmaChannel(-1);
+  bench_sdPrint("read, CPU", bench_sdRead(buffer));
+  // an odd address makes the CPU store a byte at a time, as all reads did before the FIFO was read by word
+  bench_sdPrint("read, CPU, unaligned buffer", bench_sdRead(buffer + 1));
+  sdSetDmaChannel(BENCH_SD_DMA);
+  bench_sdPrint("read, DMA", bench_sdRead(buffer));
+
+  uint32_t start = timerGet();
+  bench_sdPrint("write", sdWriteBlocks(BENCH_SD_START, BENCH_SD_BLOCKS, buffer) ? 0 : timerNsSince(start, NULL));
+
+  sdSetDmaChannel(-1);
+  free(buffer);
+}
+
+static void bench_resampler() {
+  enum { INPUT_FRAMES = 8192, OUTPUT_FRAMES = 8192, PASSES = 20 };
+  static const int rates[][2] = { {22050, 44100}, {32000, 44100}, {48000, 44100} };
+  int16_t* input = malloc(INPUT_FRAMES*4);
+  int16_t* output = malloc(OUTPUT_FRAMES*4);
+  if(input == NULL || output == NULL) {
+    uartPrintf("resampler: out of memory\n");
+    return;
+  }
+  for(int i = 0 ; i < INPUT_FRAMES*2 ; i++) {
+    input[i] = rand();
+  }
+
+  for(int r = 0 ; r < 3 ; r++) {
+    Resampler resampler;
+    resamplerInit(&resampler, rates[r][0], rates[r][1]);
+    uint32_t frames = 0;
+    uint32_t start = timerGet();
+    for(int pass = 0 ; pass < PASSES ; pass++) {
+      int used;
+      frames += resamplerProcess(&resampler, input, INPUT_FRAMES, output, OUTPUT_FRAMES, &used);
+    }
+    unsigned long ns = timerNsSince(start, NULL);
+    // output frames per second per MHz of CPU clock
+    uartPrintf("resampler %d -> %d: %lu frames per MHz\n", rates[r][0], rates[r][1],
+	       (unsigned long)(bench_perSecond(frames, ns)/CPU_MHZ));
+  }
+
+  free(output);
+  free(input);
+}
+
+static void bench_jobs() {
+  enum { JOBS = 10240, BATCH = 32 };
+  mailboxPost(BENCH_JOBS_START, 0, 0, 0);
+  if(jobConnect(1000000000)) {
+    uartPrintf("jobs: worker didn't start\n");
+    return;
+  }
+
+  // one at a time is the whole round trip, batches show the cost per job once the ARM940T is kept busy
+  uint32_t start = timerGet();
+  for(int i = 0 ; i < JOBS ; i++) {
+    jobWait(jobSubmit(BENCH_JOB_EMPTY, 0, 0, 0, 0));
+  }
+  unsigned long ns = timerNsSince(start, NULL);
+  uartPrintf("jobs: %lu ns per job submitted and waited for one at a time\n", ns/JOBS);
+
+  Job batch[BATCH];
+  for(int i = 0 ; i < BATCH ; i++) {
+    batch[i] = (Job){ .function = BENCH_JOB_EMPTY };
+  }
+  start = timerGet();
+  for(int i = 0 ; i < JOBS ; i += BATCH) {
+    jobSubmitBatch(batch, BATCH);
+  }
+  jobWaitAll();
+  ns = timerNsSince(start, NULL);
+  uartPrintf("jobs: %lu ns per job in batches of %d\n", ns/JOBS, BATCH);
+}
+
+// the remaining benchmarks are about the caches, which are off until now
+static void bench_cachesOn() {
+  static bool on = false;
+  if(!on) {
+    mmuCachesInitOn();
+    on = true;
+  }
+}
+
+#define BENCH_MEM_DMA 5
+#define BENCH_DIRTY_BYTES 0x4000 // enough to fill the data cache with dirty lines
+
+/*
+  A small buffer handed to the DMA controller and back, with the cache full of other dirty data as it would be in a
+  game. The whole cache way is how it had to be done before the range functions: clean everything before and clean
+  and invalidate everything after.
+*/
+static void bench_dmaHandoff() {
+  enum { BYTES = 512, HANDOFFS = 1000 };
+  uint8_t* dirty = memalign(32, BENCH_DIRTY_BYTES);
+  uint32_t* src = memalign(32, BYTES);
+  uint32_t* dest = memalign(32, BYTES);
+  if(dirty == NULL || src == NULL || dest == NULL) {
+    uartPrintf("dma handoff: out of memory\n");
+    return;
+  }
+  bench_cachesOn();
+  dmaConfigureChannelMem(BENCH_MEM_DMA, WORDS_8, 1, 1);
+
+  for(int whole = 0 ; whole < 2 ; whole++) {
+    unsigned long ns = 0;
+    for(int i = 0 ; i < HANDOFFS ; i++) {
+      memset(dirty, i, BENCH_DIRTY_BYTES);
+      for(int w = 0 ; w < BYTES/4 ; w++) {
+	src[w] = i + w;
+      }
+
+      uint32_t start = timerGet();
+      if(whole) {
+	cacheCleanD();
+	cacheDrainWriteBuffer();
+      } else {
+	cacheCleanRange(src, BYTES);
+      }
+      dmaStart(BENCH_MEM_DMA, BYTES, (uint32_t)src, (uint32_t)dest);
+      while(!dmaHasFinished(BENCH_MEM_DMA));
+      if(whole) {
+	cacheCleanD();
+	cacheInvalidateD();
+      } else {
+	cacheInvalidateRange(dest, BYTES);
+      }
+      ns += timerNsSince(start, NULL);
+
+      if(dest[BYTES/4 - 1] != i + BYTES/4 - 1) {
+	uartPrintf("dma handoff: wrong data\n");
+	return;
+      }
+    }
+    uartPrintf("dma handoff %d bytes, %s: %lu ns\n", BYTES, whole ? "whole cache" : "range", ns/HANDOFFS);
+  }
+
+  free(dest);
+  free(src);
+  free(dirty);
+}
+
+/*
+  A lookup table inner loop run in between reads of a buffer much bigger than the cache, as when assets are being
+  loaded. Unlocked, the table is evicted each time and the loop runs from memory, locked it should take the same
+  time every run.
+*/
+static void bench_lockdown() {
+  enum { TABLE_WORDS = 512, LOOKUPS = 4096, PRESSURE_BYTES = 0x10000, RUNS = 200 };
+  uint32_t* table = memalign(32, TABLE_WORDS*4);
+  volatile uint32_t* pressure = memalign(32, PRESSURE_BYTES);
+  if(table == NULL || pressure == NULL) {
+    uartPrintf("lockdown: out of memory\n");
+    return;
+  }
+  for(int i = 0 ; i < TABLE_WORDS ; i++) {
+    table[i] = rand();
+  }
+  bench_cachesOn();
+
+  uint32_t sum = 0;
+  for(int locked = 0 ; locked < 2 ; locked++) {
+    if(locked && cacheLockD(table, TABLE_WORDS*4)) {
+      uartPrintf("lockdown: couldn't lock\n");
+      break;
+    }
+
+    unsigned long total = 0, worst = 0;
+    for(int run = 0 ; run < RUNS ; run++) {
+      for(int i = 0 ; i < PRESSURE_BYTES/4 ; i += 8) {
+	sum += pressure[i];
+      }
+
+      uint32_t start = timerGet();
+      uint32_t index = run;
+      for(int i = 0 ; i < LOOKUPS ; i++) {
+	index = (index*1103515245 + 12345) & (TABLE_WORDS - 1);
+	sum += table[index];
+      }
+      unsigned long ns = timerNsSince(start, NULL);
+      total += ns;
+      worst = ns > worst ? ns : worst;
+    }
+    uartPrintf("lockdown %s: %lu us average, %lu us worst\n", locked ? "locked" : "unlocked", total/RUNS/1000,
+	       worst/1000);
+  }
+
+  cacheUnlockD();
+  uartPrintf("lockdown: checksum %lu\n", (unsigned long)sum); // keeps the loops from being optimised away
+  free((void*)pressure);
+  free(table);
+}
+
+/*
+  The CPU spins on the accelerator after every synchronous blit, so it has no idle time. A list is recorded and
+  submitted, then runs from the GRP2D interrupt, leaving the CPU free until the list is done.
+*/
+static void bench_blits() {
+  enum { BLIT_W = 16, BLIT_H = 16, BLITS = 1024, BATCHES = 20 };
+  uint16_t* pixels = memalign(32, BLIT_W*BLIT_H*2);
+  uint16_t* positions = malloc(BLITS*2*sizeof(uint16_t));
+  RasterList list;
+  if(pixels == NULL || positions == NULL || rgbListInit(&list, BLITS)) {
+    uartPrintf("blits: out of memory\n");
+    return;
+  }
+  for(int i = 0 ; i < BLIT_W*BLIT_H ; i++) {
+    pixels[i] = rand();
+  }
+  for(int i = 0 ; i < BLITS ; i++) {
+    positions[i*2] = rand() % (SCREEN_W - BLIT_W);
+    positions[i*2 + 1] = rand() % (SCREEN_H - BLIT_H);
+  }
+  Graphic src = { pixels, BLIT_W, BLIT_H, RGB565 };
+  Rect srcRect = { 0, 0, BLIT_W, BLIT_H };
+
+  uint32_t start = timerGet();
+  for(int batch = 0 ; batch < BATCHES ; batch++) {
+    for(int i = 0 ; i < BLITS ; i++) {
+      rgbBlit(&src, &srcRect, &screen, positions[i*2], positions[i*2 + 1], false);
+      rgbRasterRun();
+      rgbRasterWaitComplete();
+    }
+  }
+  unsigned long ns = timerNsSince(start, NULL);
+  uartPrintf("blits: synchronous %lu %dx%d blits per 60Hz frame, CPU idle 0%%\n",
+	     (unsigned long)(((uint64_t)BLITS*BATCHES*FRAME_NS)/ns), BLIT_W, BLIT_H);
+
+  rgbRasterUseInterrupts(true);
+  unsigned long busy = 0;
+  ns = 0;
+  for(int batch = 0 ; batch < BATCHES ; batch++) {
+    start = timerGet();
+    rgbListClear(&list);
+    for(int i = 0 ; i < BLITS ; i++) {
+      rgbListBlit(&list, &src, &srcRect, &screen, positions[i*2], positions[i*2 + 1], false);
+    }
+    rgbListSubmit(&list);
+    busy += timerNsSince(start, NULL);
+    while(rgbListIsRunning(&list));
+    ns += timerNsSince(start, NULL);
+  }
+  rgbRasterUseInterrupts(false);
+  uartPrintf("blits: list %lu %dx%d blits per 60Hz frame, CPU idle %lu%%\n",
+	     (unsigned long)(((uint64_t)BLITS*BATCHES*FRAME_NS)/ns), BLIT_W, BLIT_H,
+	     (unsigned long)(((uint64_t)(ns - busy)*100)/ns));
+
+  rgbListFree(&list);
+  free(positions);
+  free(pixels);
+}
+
+/*
+  Only programs the accelerator without running it, so the time is the per-blit setup alone. The blits are laid out
+  like a tile map's, sharing source, destination, size and ROP, which leaves the shadow only the addresses to write.
+  Forgetting the state before every blit writes every register, as rgbRasterOp() did before it kept the shadow.
+*/
+static void bench_blitSetup() {
+  enum { TILE_W = 16, TILE_H = 16, SET_COLS = 8, BLITS = 20000 };
+  uint16_t* pixels = memalign(32, SET_COLS*TILE_W*TILE_H*2);
+  if(pixels == NULL) {
+    uartPrintf("blit setup: out of memory\n");
+    return;
+  }
+  Graphic tileset = { pixels, SET_COLS*TILE_W, TILE_H, RGB565 };
+  Rect tile = { 0, 0, TILE_W, TILE_H };
+  const int cols = SCREEN_W/TILE_W;
+  const int rows = SCREEN_H/TILE_H;
+
+  for(int forget = 0 ; forget < 2 ; forget++) {
+    rgbRasterForgetState();
+    uint32_t start = timerGet();
+    for(int i = 0 ; i < BLITS ; i++) {
+      if(forget) {
+	rgbRasterForgetState();
+      }
+      tile.x = (i % SET_COLS)*TILE_W;
+      rgbBlit(&tileset, &tile, &screen, (i % cols)*TILE_W, ((i/cols) % rows)*TILE_H, false);
+    }
+    unsigned long ns = timerNsSince(start, NULL);
+    uartPrintf("blit setup: %s %lu ns per blit\n", forget ? "every register" : "shadowed",
+	       (unsigned long)(ns/BLITS));
+  }
+  free(pixels);
+}
+
+int main() {
+  gp2xInit();
+  irqInit();
+  gp2xSetCpuSpeed(CPU_MHZ);
+
+  uint16_t* fb = memalign(32, SCREEN_W*SCREEN_H*2);
+  if(fb == NULL) {
+    uartPrintf("out of memory\n");
+    return 1;
+  }
+  memset(fb, 0, SCREEN_W*SCREEN_H*2);
+  screen = (Graphic){ fb, SCREEN_W, SCREEN_H, RGB565 };
+  rgbSetFbAddress(fb);
+
+  bench_mixer();
+  bench_sprites();
+  bench_tileMap();
+  bench_sd();
+  bench_resampler();
+  bench_blits();
+  bench_blitSetup();
+  if(bench_start940()) {
+    bench_ring();
+    bench_mailbox();
+    bench_jobs();
+  } else {
+    uartPrintf("ARM940T didn't start\n");
+  }
+
+  bench_dmaHandoff();
+  bench_lockdown();
+
+  uartPrintf("done\n");
+  for(;;) {
+    irqWaitForInterrupt();
+  }
+}
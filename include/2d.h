@@ -6,6 +6,7 @@
 #define __ORCUS_2D_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <rgb.h>
 
 /**
@@ -48,6 +49,29 @@ typedef struct {
   /** Offset pattern by the given number of pixels in the Y direction */ int yOffset;
 } RasterPattern;
 
+/**
+   A list of raster operations recorded to run back to back on the 2D accelerator. Treat as opaque.
+ */
+typedef struct {
+  /** Recorded operations */ void* commands;
+  /** Maximum number of operations */ int capacity;
+  /** Number of operations recorded */ int count;
+  /** Next operation to run */ volatile int next;
+  /** Area operations are clipped to, if clipped is set */ Rect clip;
+  /** Operations are clipped to clip if true */ bool clipped;
+} RasterList;
+
+/**
+   A sprite to draw with rgbListSprites() or rgbDrawSprites().
+ */
+typedef struct {
+  /** Graphic to draw from */ Graphic* src;
+  /** Area of the graphic to draw */ Rect srcRect;
+  /** X-coordinate of upper left corner on the destination, can be off the edge */ int x;
+  /** Y-coordinate of upper left corner on the destination, can be off the edge */ int y;
+  /** The transparent colour will be omitted if true */ bool transparent;
+} Sprite;
+
 ///@{
 /** Pre-defined GDI ternary raster operation, the full list can be found on the 
     <a href="https://docs.microsoft.com/en-us/windows/win32/gdi/ternary-raster-operations">Microsoft website</a>.
@@ -151,6 +175,15 @@ extern void rgbSolidFill(Graphic* dest, Rect* region, uint16_t colour);
  */
 extern void rgbRasterOp(Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uint8_t rasterOp, RasterPattern* pattern, bool enableTransparency, uint16_t srcFgCol, uint16_t srcBgCol);
 
+/**
+   @brief Forget the raster registers.
+
+   The raster functions remember what they last wrote to the accelerator and skip writing registers which already 
+   hold the right value. Call this after anything else has written to the raster registers (or reset the 
+   accelerator), so the next operation writes all of them.
+ */
+extern void rgbRasterForgetState();
+
 /**
    @brief Start running pre-configured raster operation.
 
@@ -174,6 +207,206 @@ extern bool rgbRasterIsRunning();
  */
 extern void rgbRasterWaitComplete();
 
+/**
+   @brief Run raster lists from the 2D accelerator interrupt.
+
+   Start each operation in a raster list from the GRP2D interrupt as soon as the previous one finishes, so lists
+   run in the background without being polled, and rgbListWait() sleeps until the list is done. Without interrupts,
+   lists only move on when rgbListProcess() or rgbListWait() is called.
+
+   @note Must have called irqInit first
+
+   @param enable true to use the interrupt, false to poll
+ */
+extern void rgbRasterUseInterrupts(bool enable);
+
+/**
+   @brief Set up a raster list.
+
+   Allocate space for a raster list.
+
+   @param list List to set up
+   @param capacity Maximum number of operations the list can hold
+   @return 0 if successful, non-zero if out of memory
+ */
+extern int rgbListInit(RasterList* list, int capacity);
+
+/**
+   @brief Free a raster list.
+
+   Wait for a raster list to finish running and free its memory.
+
+   @param list List to free
+ */
+extern void rgbListFree(RasterList* list);
+
+/**
+   @brief Empty a raster list.
+
+   Wait for a raster list to finish running, then remove all the operations recorded in it so it can be recorded 
+   again.
+
+   @param list List to empty
+ */
+extern void rgbListClear(RasterList* list);
+
+/**
+   @brief Clip recorded operations.
+
+   Clip operations recorded into a raster list from now on to an area of their destination, e.g. to redraw just the 
+   part of the screen which has changed. Operations entirely outside the area are dropped, and the rest are cut 
+   down to it with the source moved to match.
+
+   @note Pattern fills are moved vertically to match, but the accelerator has no horizontal pattern offset so a 
+   pattern which isn't the same in every column can shift when clipped on the left.
+
+   @param list List to clip
+   @param clip Area to clip to, or NULL to stop clipping
+ */
+extern void rgbListSetClip(RasterList* list, const Rect* clip);
+
+/**
+   @brief Record a raster operation.
+
+   As rgbRasterOp(), but records the operation at the end of a list rather than configuring the accelerator. The 
+   graphics are read when the operation runs, and pattern fills use whatever is in the pattern memory at that time.
+
+   @warning Don't record into a list while it is running.
+
+   @param list List to record into
+   @param src Source graphic to copy (NULL if not used)
+   @param srcRect Area of source graphic to copy (NULL if not used)
+   @param dest Destination graphic to render onto
+   @param destRect Area of destination graphic to render onto
+   @param rasterOp Raster operation
+   @param pattern Configuration of pattern (NULL if not used)
+   @param enableTransparency The transparent colour will be omitted from the copy if true
+   @param srcFgCol Foreground colour to use when expanding 1bpp source, in the destination format
+   @param srcBgCol Background colour to use when expanding 1bpp source, in the destination format
+   @return 0 if successful (including when the operation is clipped away), non-zero if the list is full
+   @see rgbRasterOp
+ */
+extern int rgbListRasterOp(RasterList* list, Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uint8_t rasterOp, RasterPattern* pattern, bool enableTransparency, uint16_t srcFgCol, uint16_t srcBgCol);
+
+/**
+   @brief Record a blit.
+
+   As rgbBlit(), but records the operation at the end of a list.
+
+   @param list List to record into
+   @param src Source graphic to copy
+   @param srcRect Area of source graphic to copy
+   @param dest Destination graphic to copy onto
+   @param x X-coordinate of upper left hand corner of where the source graphic should be drawn on the destination
+   @param y Y-coordinate of upper left hand corner of where the source graphic should be drawn on the destination
+   @param enableTransparency The transparent colour will be omitted from the copy if true
+   @return 0 if successful, non-zero if the list is full
+   @see rgbBlit
+ */
+extern int rgbListBlit(RasterList* list, Graphic* src, Rect* srcRect, Graphic* dest, int x, int y, bool enableTransparency);
+
+/**
+   @brief Record a solid fill.
+
+   As rgbSolidFill(), but records the operation at the end of a list.
+
+   @param list List to record into
+   @param dest Destination graphic to fill
+   @param region Region of destination to fill
+   @param colour Colour to fill area with in destination format
+   @return 0 if successful, non-zero if the list is full
+   @see rgbSolidFill
+ */
+extern int rgbListSolidFill(RasterList* list, Graphic* dest, Rect* region, uint16_t colour);
+
+/**
+   @brief Record a pattern fill.
+
+   As rgbPatternFill(), but records the operation at the end of a list.
+
+   @param list List to record into
+   @param dest Destination graphic to fill
+   @param region Region of destination to fill
+   @param pattern Configuration of pattern to fill with
+   @param enableTransparency The transparent colour will be omitted from the fill
+   @return 0 if successful, non-zero if the list is full
+   @see rgbPatternFill
+ */
+extern int rgbListPatternFill(RasterList* list, Graphic* dest, Rect* region, RasterPattern* pattern, bool enableTransparency);
+
+/**
+   @brief Record a batch of sprites.
+
+   Record blits for an array of sprites, in order, at the end of a raster list. Sprites are clipped against the 
+   destination (and the clip rectangle if given, and the list's clip if set), and sprites which end up with nothing 
+   to draw are skipped. This is much cheaper per sprite than a blit each, as everything which is the same for all 
+   the sprites is only worked out once. Sprites from the same graphic are cheapest kept together.
+
+   @param list List to record into
+   @param sprites Sprites to draw
+   @param count Number of sprites
+   @param dest Destination graphic to draw onto
+   @param clip Area of the destination to draw within, or NULL for all of it
+   @return Number of sprites dealt with, less than count if the list filled up
+   @see rgbListBlit
+ */
+extern int rgbListSprites(RasterList* list, const Sprite* sprites, int count, Graphic* dest, const Rect* clip);
+
+/**
+   @brief Draw a batch of sprites.
+
+   Draw an array of sprites using rgbListSprites() with a raster list of its own, returning once they have all been 
+   drawn.
+
+   @warning This allocates a raster list each call, keep a list and use rgbListSprites() to avoid that.
+
+   @param sprites Sprites to draw
+   @param count Number of sprites
+   @param dest Destination graphic to draw onto
+   @param clip Area of the destination to draw within, or NULL for all of it
+ */
+extern void rgbDrawSprites(const Sprite* sprites, int count, Graphic* dest, const Rect* clip);
+
+/**
+   @brief Start running a raster list.
+
+   Start running the operations in a raster list in order, without waiting for them to finish. Only one list runs at 
+   a time, so this first waits for any list which is already running. A list can be submitted again to repeat it.
+
+   @warning Don't use the other raster functions while a list is running.
+
+   @param list List to run
+   @see rgbRasterUseInterrupts
+ */
+extern void rgbListSubmit(RasterList* list);
+
+/**
+   @brief Check if a raster list is running.
+
+   Check if a raster list is still running.
+
+   @param list List to check
+   @return true if the list is running, false if it has finished or was never submitted
+ */
+extern bool rgbListIsRunning(RasterList* list);
+
+/**
+   @brief Move the running raster list on.
+
+   Start the next operation in the running raster list if the accelerator has finished the last one. Only needed 
+   when not using interrupts, call it regularly to keep the accelerator busy.
+ */
+extern void rgbListProcess();
+
+/**
+   @brief Wait for a raster list to finish.
+
+   Wait until every operation in a raster list has finished.
+
+   @param list List to wait for
+ */
+extern void rgbListWait(RasterList* list);
+
 /**
    @brief Configure a rotation blit operation.
 
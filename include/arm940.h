@@ -6,6 +6,7 @@
 #define __ORCUS_ARM940_H__
 
 #include <stdint.h>
+#include <irq.h>
 
 /**
    @brief Initialise ARM940T.
@@ -118,6 +119,20 @@ extern void* importPointer(uint32_t addr);
  */
 extern uint32_t exportPointer(void* ptr);
 
+/**
+   @brief Set the handler for writes to a data register.
+
+   Set a function to call when the other CPU writes to one of this CPU's data registers - arm920Data when called on
+   the ARM920T, arm940Data when called on the ARM940T. The handler is called from the IRQ_DUALCPU interrupt, which 
+   this enables.
+
+   @note Must have called irqInit first
+
+   @param reg Data register (0 - 15)
+   @param handler Function to call, or NULL to stop interrupting on this register
+ */
+extern void arm940SetDataHandler(int reg, IrqHandler handler);
+
 /**
    @var arm940Data
    @brief Pointer to start of 16x 16-bit shared data registers.
@@ -133,6 +133,48 @@ extern void audioPlaySample(uint16_t bytes, void* data);
  */
 extern bool audioSamplePlaying();
 
+/**
+   Called to fill a streaming buffer with PCM data (16-bit stereo, left then right), from the DMA interrupt once 
+   streaming is running.
+ */
+typedef void (*AudioStreamCallback)(void* buffer, int bytes);
+
+/**
+   @brief Start streaming audio.
+
+   Play a ring of buffers back to back without gaps. The callback is called to fill every buffer before playback 
+   starts, then from the DMA finished interrupt each time a buffer has been played, to refill it while the others 
+   play. Latency is (buffers - 1) * bufferBytes / (4 * sample rate) seconds, e.g. 3 buffers of 512B at 44.1kHz is 
+   about 6ms. If the callback is slow enough to cause gaps, routing IRQ_DMA to FIQ with irqSetMode() reduces the 
+   delay before the next buffer is started.
+
+   @note Must have called irqInit and audioInit first
+   @warning This allocates buffers * bufferBytes of memory.
+
+   @param buffers Number of buffers in the ring (at least 2)
+   @param bufferBytes Size of each buffer in bytes (multiple of 16, max 0xFFF0)
+   @param callback Function to fill buffers
+   @return 0 if successful, non-zero otherwise
+   @see audioStreamStop
+ */
+extern int audioStreamStart(int buffers, int bufferBytes, AudioStreamCallback callback);
+
+/**
+   @brief Stop streaming audio.
+
+   Stop streaming audio and free the buffers.
+ */
+extern void audioStreamStop();
+
+/**
+   @brief Check if audio is being streamed.
+
+   Check if audio is being streamed.
+
+   @return true if streaming has been started, false otherwise
+ */
+extern bool audioStreamIsRunning();
+
 /**
    @brief Check if headphones are connected (F100 only).
 
@@ -0,0 +1,116 @@
+/*! \file audio940.h
+    \brief Audio mixing on the ARM940T
+ */
+
+#ifndef __ORCUS_AUDIO940_H__
+#define __ORCUS_AUDIO940_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mixer.h>
+
+/**
+   @brief Run the audio service on the ARM940T.
+
+   Mix audio on the ARM940T and feed it to the AC97 DMA channel, taking voice commands from the ARM920T. This is 
+   meant to be the whole of an ARM940T program - call it after gp2xInit() and it only returns if it can't start. The 
+   ARM920T still sets up the codec with audioInit(), audioSetSampleRate() etc. and then controls voices with the 
+   audio940*() functions.
+
+   The playback buffers are a ring of buffers played back to back as with audioStreamStart(). The ARM940T polls 
+   for commands and for the DMA finishing, so there are no interrupts involved.
+
+   @note ARM940T only
+   @note The command queue is allocated from the heap, which must be write-through (cacheable but not buffered, see 
+   puSetDRegion) or not cached. Reading the queue cleans and invalidates the whole data cache, so the mixer's own 
+   write-back data is kept.
+   @warning This allocates buffers * bufferBytes of memory.
+
+   @param dmaChannel DMA channel passed to audioInit() on the ARM920T
+   @param buffers Number of buffers in the ring (at least 2)
+   @param bufferBytes Size of each buffer in bytes (multiple of 16, max 0xFFF0)
+   @return Only returns if the buffers could not be allocated, with a non-zero value, and audio940Connect() then 
+   fails straight away
+ */
+extern int audio940Service(int dmaChannel, int buffers, int bufferBytes);
+
+/**
+   @brief Connect to the audio service on the ARM940T.
+
+   Wait for audio940Service() to start on the ARM940T and pick up the location of its command queue.
+
+   @note ARM920T only
+   @note Must have called arm940Init and arm940Run first
+
+   @param timeoutNs Nanoseconds to wait for the service to start
+   @return 0 if successful, non-zero if the service failed to start or did not start in time
+ */
+extern int audio940Connect(unsigned long timeoutNs);
+
+/**
+   @brief Start a voice playing on the ARM940T.
+
+   As mixerPlay(), but carried out by the ARM940T audio service.
+
+   @note The sample data must be in memory visible to the ARM940T, and not in the ARM920T data cache.
+
+   @param voice Voice to play on (0 - MIXER_VOICES-1)
+   @param data Sample data (ARM920T address)
+   @param length Length of the sample in samples
+   @param format Format of the sample data
+   @param loop true to repeat the sample until audio940Stop() is called, false to play it once
+   @see mixerPlay
+ */
+extern void audio940Play(int voice, const void* data, int length, MixerFormat format, bool loop);
+
+/**
+   @brief Stop a voice on the ARM940T.
+
+   As mixerStop(), but carried out by the ARM940T audio service.
+
+   @param voice Voice to stop (0 - MIXER_VOICES-1)
+ */
+extern void audio940Stop(int voice);
+
+/**
+   @brief Set volume and pan of a voice on the ARM940T.
+
+   As mixerSetVolume(), but carried out by the ARM940T audio service.
+
+   @param voice Voice to change (0 - MIXER_VOICES-1)
+   @param volume Volume (0 [silent] - MIXER_UNITY [original level], higher values amplify)
+   @param pan Pan position (0 [left] - MIXER_CENTRE - 256 [right])
+ */
+extern void audio940SetVolume(int voice, int volume, int pan);
+
+/**
+   @brief Set the sample rate of a voice on the ARM940T.
+
+   As mixerSetRate(), but carried out by the ARM940T audio service.
+
+   @param voice Voice to change (0 - MIXER_VOICES-1)
+   @param sampleRate Sample rate in Hz
+ */
+extern void audio940SetRate(int voice, int sampleRate);
+
+/**
+   @brief Set the output sample rate on the ARM940T.
+
+   As mixerSetOutputRate(), but carried out by the ARM940T audio service.
+
+   @param sampleRate Sample rate in Hz
+ */
+extern void audio940SetOutputRate(int sampleRate);
+
+/**
+   @brief Check if a voice is playing on the ARM940T.
+
+   Check if a voice is playing on the ARM940T. This is updated each time the service mixes a buffer, so it lags 
+   commands by up to a buffer.
+
+   @param voice Voice to check (0 - MIXER_VOICES-1)
+   @return true if the voice is playing, false otherwise
+ */
+extern bool audio940IsPlaying(int voice);
+
+#endif
@@ -15,6 +15,12 @@
 #define MMU_FINE_ALIGN 0x2000
 
 #define SZ_1M 0x100000
+#define SZ_64K 0x10000
+#define SZ_4K 0x1000
+#define SZ_1K 0x400
+
+/** Bytes of memory held by one way of the ARM920T caches, the granularity of cache lockdown */
+#define CACHE_WAY_BYTES 256
 
 /**
    @brief Access permissions for MMU domains.
@@ -71,7 +77,7 @@ typedef enum {
    @param tablePhysicalAddr Physical address of L2 table
    @param domain Domain for this coarse descriptor (0 - 15)
  */
-#define COARSE_DESCRIPTOR(tablePhysicalAddr, domain) ((tablePhysicalAddr & 0xFFFFFC00) | (domain << 5) | BIT(4) | 0x1)
+#define COARSE_DESCRIPTOR(tablePhysicalAddr, domain) (((tablePhysicalAddr) & 0xFFFFFC00) | (domain << 5) | BIT(4) | 0x1)
 
 /**
    @brief Define a fine descriptor.
@@ -81,7 +87,7 @@ typedef enum {
    @param tablePhysicalAddr Physical address of L2 table
    @param domain Domain for this fine descriptor (0 - 15)
  */
-#define FINE_DESCRIPTOR(tablePhysicalAddr, domain) ((tablePhysicalAddr & 0xFFFFF000) | (domain << 5) | BIT(4) | 0x3)
+#define FINE_DESCRIPTOR(tablePhysicalAddr, domain) (((tablePhysicalAddr) & 0xFFFFF000) | (domain << 5) | BIT(4) | 0x3)
 
 /**
    @brief Define a large (64K) descriptor.
@@ -97,7 +103,7 @@ typedef enum {
    @param buffered Section should be buffered
    @see AP
  */
-#define LARGE_DESCRIPTOR(physicalAddr, ap3, ap2, ap1, ap0, cacheable, buffered) ((physicalAddr & 0xFFFF0000) | (ap3 << 10) | (ap2 << 8) | (ap1 << 6) | (ap0 << 4) | ((cacheable ? 1 : 0) << 3) | ((buffered ? 1 : 0) << 2) | 0x1)
+#define LARGE_DESCRIPTOR(physicalAddr, ap3, ap2, ap1, ap0, cacheable, buffered) (((physicalAddr) & 0xFFFF0000) | (ap3 << 10) | (ap2 << 8) | (ap1 << 6) | (ap0 << 4) | ((cacheable ? 1 : 0) << 3) | ((buffered ? 1 : 0) << 2) | 0x1)
 
 /**
    @brief Define a small (4K) descriptor.
@@ -113,21 +119,21 @@ typedef enum {
    @param buffered Section should be buffered
    @see AP
  */
-#define SMALL_DESCRIPTOR(physicalAddr, ap3, ap2, ap1, ap0, cacheable, buffered) ((physicalAddr & 0xFFFFF000) | (ap3 << 10) | (ap2 << 8) | (ap1 << 6) | (ap0 << 4) | ((cacheable ? 1 : 0) << 3) | ((buffered ? 1 : 0) << 2) | 0x2)
+#define SMALL_DESCRIPTOR(physicalAddr, ap3, ap2, ap1, ap0, cacheable, buffered) (((physicalAddr) & 0xFFFFF000) | (ap3 << 10) | (ap2 << 8) | (ap1 << 6) | (ap0 << 4) | ((cacheable ? 1 : 0) << 3) | ((buffered ? 1 : 0) << 2) | 0x2)
 
 
 /**
    @brief Define a tiny (1K) descriptor.
 
-   Define a small (1K page) descriptor to go into an L2 table.
+   Define a tiny (1K page) descriptor to go into a fine L2 table.
 
-   @param physicalAddr 4K aligned physical address of page
+   @param physicalAddr 1K aligned physical address of page
    @param ap Access permissions
    @param cacheable Section should be cacheable
    @param buffered Section should be buffered
    @see AP
  */
-#define TINY_DESCRIPTOR(physicalAddr, ap3, ap2, ap1, ap0, cacheable, buffered) ((physicalAddr & 0xFFFFFC00) | (ap << 4) | ((cacheable ? 1 : 0) << 3) | ((buffered ? 1 : 0) << 2) | 0x3)
+#define TINY_DESCRIPTOR(physicalAddr, ap, cacheable, buffered) (((physicalAddr) & 0xFFFFFC00) | (ap << 4) | ((cacheable ? 1 : 0) << 3) | ((buffered ? 1 : 0) << 2) | 0x3)
 
 /**
    @brief Protection Unit memory region sizes.
@@ -181,6 +187,29 @@ typedef enum {
 	      /** Full access from both privileged and user modes */ PU_FULL_ACCESS = 0x3
 } PUAccess;
 
+/**
+   @brief Memory attributes for MMU regions.
+
+   How accesses to a region of memory go through the data cache and write buffer.
+ */
+typedef enum {
+	      /** Not cached or buffered, e.g. for hardware registers */ MEM_UNCACHED = 0,
+	      /** Writes are buffered but not cached, e.g. for framebuffers and DMA buffers */ MEM_BUFFERED = 1,
+	      /** Reads are cached, writes go straight to memory */ MEM_WRITE_THROUGH = 2,
+	      /** Reads and writes are cached, written back when evicted or cleaned */ MEM_WRITE_BACK = 3
+} MemoryAttributes;
+
+/**
+   @brief A region of memory for the MMU.
+
+   A range of the address space and the attributes to map it with.
+ */
+typedef struct {
+  /** Start address */ uint32_t address;
+  /** Size in bytes */ uint32_t size;
+  /** Attributes */ MemoryAttributes attributes;
+} MemoryRegion;
+
 /**
    @brief Configures MMU domain access.
 
@@ -194,12 +223,47 @@ typedef enum {
  */
 extern uint32_t mmuSetDomainAccess(unsigned int domain, DomainAccess access);
 
+/**
+   @brief Allocates and populates a new L1 MMU table from a list of regions.
+
+   Allocates a new L1 MMU table which maps the whole address space flat (virtual address = physical address) as
+   uncached, unbuffered 1M sections in domain 0, then gives each region in the list its own attributes with
+   mmuSetRegions(). For example, RAM can be write-back while framebuffers are only buffered, so writes to them are
+   quick but the display and 2D accelerator always see what was written.
+
+   @note ARM920T only
+   @warning This should only be called after gp2xInit as it allocates memory
+
+   @param regions Regions to set up, later regions override earlier ones where they overlap
+   @param count Number of regions
+   @return A pointer to a correctly aligned L1 MMU table, or NULL if out of memory
+ */
+extern uint32_t* mmuNewL1TableFromRegions(const MemoryRegion* regions, int count);
+
+/**
+   @brief Set the memory attributes of regions in an L1 MMU table.
+
+   Rewrite the section descriptors covering each region with its attributes, keeping the flat mapping. Regions are 
+   rounded out to whole 1M sections.
+
+   @note If the table is in use, clean the data cache before a region becomes uncached and invalidate the TLBs
+   afterwards.
+   @note ARM920T only
+
+   @param l1Table L1 MMU table
+   @param regions Regions to set up, later regions override earlier ones where they overlap
+   @param count Number of regions
+ */
+extern void mmuSetRegions(uint32_t* l1Table, const MemoryRegion* regions, int count);
+
 /**
    @brief Allocates and populates a new L1 MMU table.
 
    Allocates and populates a new L1 MMU table. This will by default enable caching and buffering for the first 64M 
    of the address space (i.e. RAM) using 1M section descriptors set to domain 0.
 
+   @see mmuNewL1TableFromRegions
+
    @note ARM920T only
    @warning This should only be called after gp2xInit as it allocates memory
 
@@ -207,6 +271,78 @@ extern uint32_t mmuSetDomainAccess(unsigned int domain, DomainAccess access);
  */
 extern uint32_t* mmuNewL1Table();
 
+/**
+   @brief Allocates a new coarse L2 MMU table.
+
+   Allocates a coarse L2 table (256 entries, for 64K large and 4K small pages) with every entry set to fault. Hook it
+   into an L1 table with COARSE_DESCRIPTOR.
+
+   @note The MMU reads tables from memory, so clean them from the data cache after changing them (see
+   cacheCleanRange).
+   @note ARM920T only
+   @warning This should only be called after gp2xInit as it allocates memory
+
+   @return A pointer to a correctly aligned coarse table, or NULL if out of memory
+ */
+extern uint32_t* mmuNewCoarseTable();
+
+/**
+   @brief Allocates a new fine L2 MMU table.
+
+   Allocates a fine L2 table (1024 entries, for 64K large, 4K small and 1K tiny pages) with every entry set to fault.
+   Hook it into an L1 table with FINE_DESCRIPTOR. Small pages take 4 entries of a fine table and large pages 64.
+
+   @note The MMU reads tables from memory, so clean them from the data cache after changing them (see
+   cacheCleanRange).
+   @note ARM920T only
+   @warning This should only be called after gp2xInit as it allocates memory
+
+   @return A pointer to a correctly aligned fine table, or NULL if out of memory
+ */
+extern uint32_t* mmuNewFineTable();
+
+/**
+   @brief Map a range of pages.
+
+   Map a range of virtual addresses to physical addresses at page granularity, with its own memory attributes. 
+   Sections the range falls in are split into coarse L2 tables as needed, keeping the mapping and attributes of 
+   the rest of the section. Where the range allows, 64K large pages are used rather than 4K small pages. Parts of 
+   the range which aren't 4K aligned use 1K tiny pages, which need a fine L2 table, so the section or coarse table 
+   they are in is replaced with a fine table mapping the same thing, and a coarse table replaced this way is freed.
+
+   This allows e.g. just the audio and DMA buffers to be uncached while the rest of RAM stays write-back. The TLBs
+   are invalidated afterwards, so this can be used on the L1 table in use.
+
+   @note Clean the data cache over the range first if it is cached and becoming uncached, or moving.
+   @note ARM920T only
+   @warning This may allocate memory for L2 tables, and frees coarse tables it replaces, so any coarse table hooked
+   into l1Table by hand must come from mmuNewCoarseTable()
+
+   @param l1Table L1 MMU table
+   @param virtualAddr 1K aligned virtual address
+   @param physicalAddr 1K aligned physical address
+   @param size Size in bytes, a multiple of 1K
+   @param attributes Attributes to map the range with
+   @return 0 if successful, non-zero otherwise
+ */
+extern int mmuMapPages(uint32_t* l1Table, uint32_t virtualAddr, uint32_t physicalAddr, uint32_t size, MemoryAttributes attributes);
+
+/**
+   @brief Unmap a range of pages.
+
+   Set a range of pages to fault, e.g. to put a guard page after a stack or buffer so overruns abort rather than 
+   silently corrupting memory. Sections are split into L2 tables as for mmuMapPages().
+
+   @note ARM920T only
+   @warning This may allocate memory for L2 tables
+
+   @param l1Table L1 MMU table
+   @param virtualAddr 1K aligned virtual address
+   @param size Size in bytes, a multiple of 1K
+   @return 0 if successful, non-zero otherwise
+ */
+extern int mmuUnmapPages(uint32_t* l1Table, uint32_t virtualAddr, uint32_t size);
+
 /**
    @brief Enable the MMU.
 
@@ -297,6 +433,112 @@ extern void cacheInvalidateD();
  */
 extern void cacheCleanD();
 
+/**
+   @brief Drain the write buffer.
+
+   Wait for all buffered writes to reach memory. Writes to write-through or uncached memory which is buffered still
+   have to be drained before another CPU or the DMA controller can be sure of seeing them.
+ */
+extern void cacheDrainWriteBuffer();
+
+/**
+   @brief Clean a range of the data cache.
+
+   Write back any dirty data cache lines covering a range of memory, then drain the write buffer. Use this before 
+   the DMA controller or the other CPU reads memory written through the data cache.
+
+   @note On the ARM940T, and for ranges as big as the data cache, this cleans the whole data cache.
+
+   @param start Start of the range
+   @param bytes Size of the range in bytes
+ */
+extern void cacheCleanRange(const void* start, uint32_t bytes);
+
+/**
+   @brief Invalidate a range of the data cache.
+
+   Drop any data cache lines covering a range of memory, so the next read comes from memory. Use this after the DMA 
+   controller or the other CPU has written to memory which may be in the data cache. Lines only partly covered by 
+   the range are written back first, so data next to the range is not lost.
+
+   @note On the ARM940T, and for ranges as big as the data cache, this cleans and invalidates the whole data cache 
+   apart from lines locked with cacheLockD(), which are only cleaned.
+
+   @param start Start of the range
+   @param bytes Size of the range in bytes
+ */
+extern void cacheInvalidateRange(void* start, uint32_t bytes);
+
+/**
+   @brief Clean and invalidate a range of the data cache.
+
+   Write back and then drop any data cache lines covering a range of memory. Use this before the DMA controller 
+   writes to a buffer, so no dirty lines can be written back over the incoming data.
+
+   @note On the ARM940T, and for ranges as big as the data cache, this cleans and invalidates the whole data cache 
+   apart from lines locked with cacheLockD(), which are only cleaned.
+
+   @param start Start of the range
+   @param bytes Size of the range in bytes
+ */
+extern void cacheCleanInvalidateRange(void* start, uint32_t bytes);
+
+/**
+   @brief Lock a range of data into the data cache.
+
+   Load a range of memory into the data cache and lock it there, so it can't be evicted by other accesses. Each 
+   CACHE_WAY_BYTES block the range touches takes one of the 64 ways of the cache, and successive calls lock further 
+   ranges into the following ways. At least one way is always left unlocked.
+
+   Locked lines still act as normal cache lines, so are written back by cacheCleanD() or cacheCleanRange(). The 
+   range functions only clean locked lines when they work through the whole cache, so locked data is kept, but 
+   this means memory written by DMA shouldn't be locked. cacheInvalidateD() and cacheInvalidateDI() still drop 
+   locked lines, after which the range has to be unlocked and locked again.
+
+   @note The data cache must be enabled
+   @note ARM920T only
+
+   @param start Start of the range
+   @param bytes Size of the range in bytes
+   @return 0 if successful, non-zero if the range would leave no unlocked ways
+   @see cacheUnlockD
+ */
+extern int cacheLockD(const void* start, uint32_t bytes);
+
+/**
+   @brief Unlock the data cache.
+
+   Unlock everything locked with cacheLockD(). The data stays in the cache until it is evicted as normal.
+
+   @note ARM920T only
+ */
+extern void cacheUnlockD();
+
+/**
+   @brief Lock a range of code into the instruction cache.
+
+   As cacheLockD(), but prefetches the range into the instruction cache, e.g. for an inner loop which has to run
+   at the same speed however much other code runs between calls.
+
+   @note The instruction cache must be enabled
+   @note ARM920T only
+
+   @param start Start of the range, e.g. the address of a function
+   @param bytes Size of the range in bytes
+   @return 0 if successful, non-zero if the range would leave no unlocked ways
+   @see cacheUnlockI
+ */
+extern int cacheLockI(const void* start, uint32_t bytes);
+
+/**
+   @brief Unlock the instruction cache.
+
+   Unlock everything locked with cacheLockI().
+
+   @note ARM920T only
+ */
+extern void cacheUnlockI();
+
 /**
    @brief Invalidate both data and instruction caches.
 
@@ -0,0 +1,122 @@
+/*! \file dirty.h
+    \brief Dirty rectangle tracking
+ */
+
+#ifndef __ORCUS_DIRTY_H__
+#define __ORCUS_DIRTY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <2d.h>
+
+/**
+   @def DIRTY_MAX_RECTS
+   @brief Number of rectangles in a dirty region.
+
+   Most rectangles a dirty region keeps separate, beyond this rectangles are merged.
+ */
+#define DIRTY_MAX_RECTS 16
+
+/**
+   @def DIRTY_MAX_BUFFERS
+   @brief Number of buffers a dirty tracker can follow.
+
+   Most framebuffers a dirty tracker can keep regions for, matching the most rgbFlipInit() takes.
+ */
+#define DIRTY_MAX_BUFFERS 3
+
+/**
+   Set of rectangles which need redrawing.
+ */
+typedef struct {
+  /** Rectangles to redraw, they don't overlap each other */ Rect rects[DIRTY_MAX_RECTS];
+  /** Number of rectangles */ int count;
+} DirtyRegion;
+
+/**
+   Dirty regions for each of a set of page flipped framebuffers. Treat as opaque.
+ */
+typedef struct {
+  /** Framebuffers being followed */ void* buffers[DIRTY_MAX_BUFFERS];
+  /** Region still to redraw in each framebuffer */ DirtyRegion regions[DIRTY_MAX_BUFFERS];
+  /** Region being redrawn in each framebuffer, handed out by dirtyTrackerGet() */ DirtyRegion drawing[DIRTY_MAX_BUFFERS];
+  /** Number of framebuffers */ int count;
+  /** Area of the screen */ Rect bounds;
+} DirtyTracker;
+
+/**
+   @brief Empty a dirty region.
+
+   Remove all rectangles from a dirty region.
+
+   @param region Region to empty
+ */
+extern void dirtyClear(DirtyRegion* region);
+
+/**
+   @brief Add a rectangle to a dirty region.
+
+   Add a rectangle to a dirty region, coalescing it with the rectangles already there. Rectangles which overlap are
+   merged, as are ones whose bounding box covers no more than the two did, and once the region is full the rectangle
+   is merged with whichever existing rectangle grows the least.
+
+   @param region Region to add to
+   @param rect Rectangle to add
+ */
+extern void dirtyAdd(DirtyRegion* region, const Rect* rect);
+
+/**
+   @brief Set up a dirty tracker.
+
+   Start tracking dirty regions for a set of page flipped framebuffers, e.g. the buffers passed to rgbFlipInit().
+   Every buffer starts out entirely dirty.
+
+   @param tracker Tracker to set up
+   @param buffers Array of framebuffer pointers
+   @param count Number of buffers (1 - DIRTY_MAX_BUFFERS)
+   @param w Width of the screen in pixels
+   @param h Height of the screen in pixels
+   @return 0 if successful, non-zero otherwise
+ */
+extern int dirtyTrackerInit(DirtyTracker* tracker, void** buffers, int count, int w, int h);
+
+/**
+   @brief Mark part of the screen as changed.
+
+   Mark an area of the screen as needing to be redrawn. Every buffer has to catch up with the change, so the area is
+   added to the dirty region of each buffer.
+
+   @param tracker Tracker to mark
+   @param rect Area which has changed, clipped to the screen
+ */
+extern void dirtyTrackerAdd(DirtyTracker* tracker, const Rect* rect);
+
+/**
+   @brief Get the region of a buffer to redraw.
+
+   Get the region of a framebuffer (e.g. from rgbFlipGetBackBuffer()) which is out of date. Redraw each of its
+   rectangles, for example by recording the frame into a raster list clipped to each rectangle in turn with
+   rgbListSetClip(), then call dirtyTrackerDone().
+
+   The region is taken out of the tracker, so changes added with dirtyTrackerAdd() while the buffer is being redrawn 
+   are kept for the next frame rather than being lost. If dirtyTrackerDone() isn't called the region is handed out 
+   again, along with anything added since, by the next call.
+
+   @param tracker Tracker to look in
+   @param buffer Framebuffer about to be drawn into
+   @return Region to redraw, or NULL if the buffer isn't being tracked
+ */
+extern DirtyRegion* dirtyTrackerGet(DirtyTracker* tracker, void* buffer);
+
+/**
+   @brief Mark a buffer as up to date.
+
+   Drop the region handed out by dirtyTrackerGet() once the framebuffer has been redrawn. Changes added since then 
+   are still to be drawn.
+
+   @param tracker Tracker to update
+   @param buffer Framebuffer which has been redrawn
+ */
+extern void dirtyTrackerDone(DirtyTracker* tracker, void* buffer);
+
+#endif
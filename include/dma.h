@@ -20,6 +20,7 @@ typedef enum {
    MMSP2 peripherals available for DMA transfers.
 */
 typedef enum {
+	      SDI = 21,
 	      AC97_LRPCM = 24
 } Peripheral;
 
@@ -48,6 +49,38 @@ extern void dmaConfigureChannelMem(int channel, BurstMode burstMode, int8_t srcI
  */
 extern void dmaConfigureChannelIO(int channel, BurstMode burstMode, int8_t srcIncrement, int8_t destIncrement, Peripheral peripheral);
 
+/**
+   @brief Configure a DMA channel for peripheral-to-memory transfer.
+
+   Configure a DMA channel for peripheral-to-memory transfer. The peripheral is read 32 bits at a time.
+
+   @param channel DMA channel to configure (0 - 15)
+   @param burstMode Number of words to copy at a time
+   @param srcIncrement Number of words to increment source address after each transfer (negative values and zero are permitted)
+   @param destIncrement Number of words to increment destination address after each transfer (negative values and zero are permitted)
+   @param peripheral MMSP2 peripheral to read from
+ */
+extern void dmaConfigureChannelFromIO(int channel, BurstMode burstMode, int8_t srcIncrement, int8_t destIncrement, Peripheral peripheral);
+
+
+/**
+   Called from the DMA interrupt when a transfer on a channel has finished.
+ */
+typedef void (*DmaHandler)(int channel);
+
+/**
+   @brief Call a function when transfers on a DMA channel finish.
+
+   Enable the finished interrupt for a DMA channel and call handler from the interrupt each time a transfer on it 
+   completes. The handler can start the next transfer straight away with dmaStart().
+
+   @note Must have called irqInit first
+   @note Configuring the channel again turns the interrupt off, so call this after dmaConfigureChannel*().
+
+   @param channel DMA channel (0 - 15)
+   @param handler Function to call, or NULL to disable the interrupt for this channel
+ */
+extern void dmaSetFinishedHandler(int channel, DmaHandler handler);
 
 /**
    @brief Initiate a DMA transfer.
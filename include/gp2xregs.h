@@ -33,6 +33,14 @@ extern r32 _not_used;
 extern r32 _irq;
 extern r32 _fiq;
 
+// interrupt controller
+#define SRCPEND 0x0800 // 32bit
+#define INTMOD 0x0804 // 32bit, 1 = FIQ, 0 = IRQ
+#define INTMASK 0x0808 // 32bit, 1 = masked
+#define IPRIORITY 0x080C
+#define INTPEND 0x0810 // 32bit
+#define INTOFFSET 0x0814
+
 #define REGISTER(name, offset, size) volatile r##size name = (r##size) (0xC0000000+offset)
 
 // clock registers
@@ -324,6 +332,12 @@ extern r32 _fiq;
 #define DOF(x) (x << 1)
 #define ENB(x) (x << 0)
 
+#define DPC_INTR 0x2846
+#define DPC_INTR_VSINT BIT(0) // pending, write 1 to clear
+#define DPC_INTR_HSINT BIT(1)
+#define DPC_INTR_VSINTEN BIT(4)
+#define DPC_INTR_HSINTEN BIT(5)
+
 #define DPC_CLKCNTL 0x2848
 #define CLKSRC(x) (x << 3)
 #define CLK2SEL(x) (x << 2)
@@ -404,6 +418,10 @@ extern r32 _fiq;
 #define SDICmdSta_CMD_ON (1 << 8)
 
 #define SDIDatConL 0x1520
+#define SDIDatConL_BLK_NUM(x) (x << 0)
+#define SDIDatConL_DAT_MODE(x) (x << 12) // 2 = receive, 3 = transmit
+#define SDIDatConL_STOP BIT(14)
+#define SDIDatConL_DMA_EN BIT(15)
 #define SDIDatConH 0x1522
 #define SDIDatConH_WIDE_BUS(x) (x << 0)
 #define SDIDatConH_BLK_MODE(x) (x << 1)
@@ -422,6 +440,9 @@ extern r32 _fiq;
 
 #define SDIFSTA 0x152A
 #define SDIDatSta 0x1528
+#define SDIDatSta_DAT_FIN BIT(4)
+#define SDIDatSta_DAT_TOUT BIT(5)
+#define SDIDatSta_DAT_CRC BIT(6)
 #define SDIDAT 0x152C
 
 #define SDIDatCnt 0x1524 // 32bit
@@ -429,6 +450,18 @@ extern r32 _fiq;
 #define SDIDTimerL 0x1536
 #define SDIDTimerH 0x1538
 
+#define SDIIntEnL 0x153C
+#define SDIIntEnL_RF_HALF BIT(0)
+#define SDIIntEnL_RF_FULL BIT(1)
+#define SDIIntEnL_RF_LAST BIT(2)
+#define SDIIntEnL_TF_EMPTY BIT(3)
+#define SDIIntEnL_TF_HALF BIT(4)
+#define SDIIntEnL_BUSY_FIN BIT(5)
+#define SDIIntEnL_DAT_FIN BIT(7)
+#define SDIIntEnL_DAT_TOUT BIT(8)
+#define SDIIntEnL_DAT_CRC BIT(9)
+#define SDIIntEnH 0x153E
+
 #define TCOUNT 0x0A00
 #define TCONTROL 0x0A14
 
@@ -443,6 +476,8 @@ extern r32 _fiq;
 #define DUAL940DAT0 0x3B20
 #define DUALINT920 0x3B40
 #define DUALINT940 0x3B42
+#define DUALPEND920 0x3B44
+#define DUALPEND940 0x3B46
 #define DUALCTRL940 0x3B48
 
 typedef struct {
@@ -500,13 +535,18 @@ typedef struct {
 #define DMACOM1 0x0202
 #define DMACOM2 0x0204
 #define DMACONS 0x0206
+#define DMACONS_END BIT(1)
+#define DMACONS_IRQ_EN BIT(9)
+#define DMACONS_RUN BIT(10)
 #define DMASRCADDR 0x0208
 #define DMATRGADDR 0x020C
 #define DMAREG(reg, channel) (reg+(0x10*channel))
+#define DMAINT 0x0000 // one bit per channel, write 1 to clear
 
 #define DCH0SRM 0x0100
 #define DCH0TRM 0x0102
 
+#define AUDIO_BASE 0xC0000E00 // physical address of the PCM output, for DMA
 #define AC_CTRL_REG 0x0E00
 #define AC_STA_ENA_REG 0x0E04
 #define AC_STATUS_REG 0x0E06
@@ -525,6 +565,8 @@ typedef struct {
 #define SIZE 0x2402C
 #define CTRL 0x24030
 #define RUN 0x24034
+#define RUN_START BIT(0)
+#define RUN_INTR BIT(1) // operation finished interrupt, write 1 to clear
 #define PATCTRL 0x24020
 #define PATFORCOLOR 0x24024
 #define PATBACKCOLOR 0x24028
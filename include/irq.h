@@ -0,0 +1,184 @@
+/*! \file irq.h
+    \brief Interrupts
+ */
+
+#ifndef __ORCUS_IRQ_H__
+#define __ORCUS_IRQ_H__
+
+#include <stdint.h>
+
+/**
+   MMSP2 interrupt sources, the value is the bit used in the interrupt controller registers.
+ */
+typedef enum {
+	      /** Display controller (vsync) */ IRQ_DISP = 0,
+	      /** Image capture hsync */ IRQ_IMGH = 1,
+	      /** Image capture vsync */ IRQ_IMGV = 2,
+	      /** Timer */ IRQ_TIMER = 5,
+	      /** Memory stick */ IRQ_MSTICK = 6,
+	      /** SSP */ IRQ_SSP = 7,
+	      /** PPM */ IRQ_PPM = 8,
+	      /** DMA controller */ IRQ_DMA = 9,
+	      /** UARTs */ IRQ_UART = 10,
+	      /** 2D accelerator */ IRQ_GRP2D = 11,
+	      /** Scaler */ IRQ_SCALER = 12,
+	      /** USB host */ IRQ_USBH = 13,
+	      /** SD controller */ IRQ_SD = 14,
+	      /** USB device */ IRQ_USBD = 15,
+	      /** Real time clock */ IRQ_RTC = 16,
+	      /** ADC */ IRQ_ADC = 17,
+	      /** I2C */ IRQ_I2C = 18,
+	      /** AC97 */ IRQ_AC97 = 19,
+	      /** IrDA */ IRQ_IRDA = 20,
+	      /** GPIO */ IRQ_GPIO = 23,
+	      /** CD-ROM */ IRQ_CDROM = 24,
+	      /** One wire master */ IRQ_OWM = 25,
+	      /** 920/940 interchange registers */ IRQ_DUALCPU = 26,
+	      /** Memory controller */ IRQ_MCUC = 27,
+	      /** VLD */ IRQ_VLD = 28,
+	      /** Video processor */ IRQ_VIDEO = 29,
+	      /** MPEG interface */ IRQ_MPEGIF = 30,
+	      /** I2S */ IRQ_I2S = 31
+} InterruptSource;
+
+/**
+   How an interrupt source is delivered to the ARM920T.
+ */
+typedef enum {
+	      /** Normal interrupt */ IRQ_MODE_IRQ = 0,
+	      /** Fast interrupt */ IRQ_MODE_FIQ = 1
+} InterruptMode;
+
+/**
+   ARM exception vectors which can be replaced.
+ */
+typedef enum {
+	      VECTOR_UNDEFINED_INSTRUCTION = 0,
+	      VECTOR_SOFTWARE_INTERRUPT = 1,
+	      VECTOR_PREFETCH_ABORT = 2,
+	      VECTOR_DATA_ABORT = 3,
+	      VECTOR_IRQ = 4,
+	      VECTOR_FIQ = 5
+} ExceptionVector;
+
+/**
+   Interrupt handler. Called in IRQ or FIQ mode with interrupts of the same kind disabled, the interrupt is 
+   acknowledged after the handler returns.
+ */
+typedef void (*IrqHandler)();
+
+/**
+   Exception handler, installed directly on an exception vector so it must be written as one (e.g. using 
+   __attribute__((interrupt("ABORT")))).
+ */
+typedef void (*ExceptionHandler)();
+
+/**
+   @brief Set up interrupt handling.
+
+   Mask and clear all interrupt sources and route them all to IRQ, give IRQ and FIQ modes their own stacks, install
+   the IRQ and FIQ dispatchers and enable both on the ARM920T. Sources are then enabled one at a time with 
+   irqSetHandler() and irqEnable().
+
+   The interrupt controller belongs to the ARM920T. On the ARM940T this only installs the IRQ dispatcher, which 
+   calls the IRQ_DUALCPU handler - the only interrupt the ARM940T can take is from the data registers (see 
+   arm940SetDataHandler). irqEnable(), irqDisable() and irqSetMode() do nothing there.
+
+   @note Must have called gp2xInit first
+ */
+extern void irqInit();
+
+/**
+   @brief Set the handler for an interrupt source.
+
+   Set the function called when an interrupt source fires. Handlers should clear the condition in the peripheral
+   which raised the interrupt, otherwise it will fire again as soon as the handler returns.
+
+   @param source Interrupt source
+   @param handler Function to call, or NULL to ignore the source
+ */
+extern void irqSetHandler(InterruptSource source, IrqHandler handler);
+
+/**
+   @brief Route an interrupt source to IRQ or FIQ.
+
+   Choose whether an interrupt source is delivered as an IRQ or a FIQ. The same handler set with irqSetHandler() is 
+   called either way. FIQ is best kept for a single source which needs low latency, e.g. an audio buffer running out.
+
+   @param source Interrupt source
+   @param mode IRQ_MODE_IRQ or IRQ_MODE_FIQ
+ */
+extern void irqSetMode(InterruptSource source, InterruptMode mode);
+
+/**
+   @brief Replace an exception vector.
+
+   Install a handler directly on one of the ARM exception vectors. Replacing VECTOR_IRQ or VECTOR_FIQ bypasses the 
+   handlers registered with irqSetHandler().
+
+   @param vector Vector to replace
+   @param handler Exception handler
+   @return Handler previously installed on the vector
+ */
+extern ExceptionHandler irqSetVector(ExceptionVector vector, ExceptionHandler handler);
+
+/**
+   @brief Enable an interrupt source.
+
+   Unmask an interrupt source in the interrupt controller.
+
+   @param source Interrupt source
+ */
+extern void irqEnable(InterruptSource source);
+
+/**
+   @brief Disable an interrupt source.
+
+   Mask an interrupt source in the interrupt controller.
+
+   @param source Interrupt source
+ */
+extern void irqDisable(InterruptSource source);
+
+/**
+   @brief Disable IRQs on this core.
+
+   Set the I bit in the CPSR so no IRQs are taken until irqResume() is called.
+
+   @return Previous state to pass to irqResume()
+   @see irqResume
+ */
+extern uint32_t irqSuspend();
+
+/**
+   @brief Disable IRQs and FIQs on this core.
+
+   Set the I and F bits in the CPSR so no interrupts at all are taken until irqResume() is called. Use this around 
+   anything shared with a FIQ handler.
+
+   @return Previous state to pass to irqResume()
+   @see irqResume
+ */
+extern uint32_t irqSuspendAll();
+
+/**
+   @brief Restore IRQs on this core.
+
+   Restore the I and F bits in the CPSR to the state they were in before the matching irqSuspend() or 
+   irqSuspendAll(). Calls can be nested, only the outermost irqResume() enables interrupts again.
+
+   @param state Value returned by irqSuspend() or irqSuspendAll()
+   @see irqSuspend
+ */
+extern void irqResume(uint32_t state);
+
+/**
+   @brief Wait for an interrupt.
+
+   Stop the core until an interrupt is raised. The core also wakes for interrupts while IRQs are suspended, so
+   the usual pattern is to call irqSuspend(), check whether there is still work to wait for, call this function and
+   then irqResume() to let the handler run.
+ */
+extern void irqWaitForInterrupt();
+
+#endif
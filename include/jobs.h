@@ -0,0 +1,169 @@
+/*! \file jobs.h
+    \brief Running jobs on the ARM940T
+ */
+
+#ifndef __ORCUS_JOBS_H__
+#define __ORCUS_JOBS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+   @def JOB_FUNCTIONS
+   @brief Number of job functions.
+
+   Number of functions the ARM940T worker can have registered at once.
+ */
+#define JOB_FUNCTIONS 32
+
+/**
+   @def JOB_ARGS
+   @brief Number of job arguments.
+
+   Number of 32-bit arguments passed to each job.
+ */
+#define JOB_ARGS 4
+
+/**
+   Job function, run on the ARM940T. Arguments are passed through as they were submitted, so pointers from the
+   ARM920T have to be converted with importPointer().
+ */
+typedef void (*JobFunction)(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+/**
+   A job to run on the ARM940T.
+ */
+typedef struct {
+  /** Function to run, as registered with jobRegister() */ uint32_t function;
+  /** Arguments to pass to the function */ uint32_t args[JOB_ARGS];
+} Job;
+
+/**
+   Identifies a submitted job, for checking whether it has finished. Jobs finish in the order they were submitted.
+ */
+typedef uint32_t JobTicket;
+
+/**
+   @brief Register a job function on the ARM940T.
+
+   Make a function available to jobs submitted from the ARM920T. The two CPUs run separate programs, so jobs refer
+   to functions by number rather than by pointer.
+
+   @note ARM940T only
+
+   @param function Function number (0 - JOB_FUNCTIONS-1)
+   @param fn Function to run, or NULL to remove it
+ */
+extern void jobRegister(int function, JobFunction fn);
+
+/**
+   @brief Run the job worker on the ARM940T.
+
+   Run jobs submitted from the ARM920T one at a time, in order. Register job functions with jobRegister() first -
+   jobs for unregistered functions are skipped, but still finish. This is meant to be the whole of an ARM940T
+   program once set up, and only returns if it can't start.
+
+   @note ARM940T only
+   @note The job queue is allocated from the heap, which must be write-through (cacheable but not buffered, see
+   puSetDRegion) or not cached. Reading the queue cleans and invalidates the whole data cache, so the jobs' own
+   write-back data is kept.
+
+   @return Only returns if the job queue could not be allocated, with a non-zero value, and jobConnect() then fails
+   straight away
+ */
+extern int jobWorker();
+
+/**
+   @brief Connect to the job worker on the ARM940T.
+
+   Wait for jobWorker() to start on the ARM940T and pick up the location of its job queue.
+
+   @note ARM920T only
+   @note Must have called arm940Init and arm940Run first
+
+   @param timeoutNs Nanoseconds to wait for the worker to start
+   @return 0 if successful, non-zero if the worker failed to start or did not start in time
+ */
+extern int jobConnect(unsigned long timeoutNs);
+
+/**
+   @brief Sleep while waiting for jobs.
+
+   Have the ARM940T interrupt the ARM920T each time a job finishes, so jobWait() and jobWaitAll() can stop the core
+   until then rather than spinning on the shared registers.
+
+   @note ARM920T only
+   @note Must have called irqInit first
+
+   @param enable true to wait on the interrupt, false to spin
+ */
+extern void jobUseInterrupts(bool enable);
+
+/**
+   @brief Submit a job to the ARM940T.
+
+   Queue a single job to run on the ARM940T. Waits for space if the queue is full.
+
+   @note ARM920T only
+   @note Memory the job reads from must be clean in the ARM920T data cache, and memory it writes to must be
+   invalidated before the ARM920T reads it after the job has finished (see cacheCleanRange and cacheInvalidateRange).
+
+   @param function Function to run, as registered with jobRegister() on the ARM940T
+   @param arg0 First argument
+   @param arg1 Second argument
+   @param arg2 Third argument
+   @param arg3 Fourth argument
+   @return Ticket for the job
+   @see jobIsDone
+ */
+extern JobTicket jobSubmit(int function, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+/**
+   @brief Submit several jobs to the ARM940T.
+
+   Queue several jobs in one go, which costs less per job than jobSubmit() as the ARM940T is only told once for
+   as many jobs as fit in the queue. Waits for space if the queue is full.
+
+   @note ARM920T only
+
+   @param jobs Jobs to run, in order
+   @param count Number of jobs
+   @return Ticket for the last job, all the jobs before it have finished once it has
+   @see jobSubmit
+ */
+extern JobTicket jobSubmitBatch(const Job* jobs, int count);
+
+/**
+   @brief Check if a job has finished.
+
+   Check if a job has finished running on the ARM940T.
+
+   @note ARM920T only
+
+   @param ticket Ticket returned by jobSubmit() or jobSubmitBatch()
+   @return true if the job has finished, false otherwise
+ */
+extern bool jobIsDone(JobTicket ticket);
+
+/**
+   @brief Wait for a job to finish.
+
+   Wait for a job, and all jobs submitted before it, to finish running on the ARM940T.
+
+   @note ARM920T only
+
+   @param ticket Ticket returned by jobSubmit() or jobSubmitBatch()
+   @see jobUseInterrupts
+ */
+extern void jobWait(JobTicket ticket);
+
+/**
+   @brief Wait for all jobs to finish.
+
+   Wait for every job submitted so far to finish running on the ARM940T.
+
+   @note ARM920T only
+ */
+extern void jobWaitAll();
+
+#endif
@@ -20,6 +20,8 @@ extern bool lcdVSync();
    @brief Wait until LCD is in next vsync period.
 
    Wait until LCD is in next vsync period. If LCD is currently in vsync when this is called, it will wait until it has ended, and then again until the next one begins.
+
+   While page flipping is running (see rgbFlipInit) this sleeps until the vsync interrupt instead of polling.
  */
 extern void lcdWaitNextVSync();
 
@@ -0,0 +1,84 @@
+/*! \file mailbox.h
+    \brief Messages between the ARM920T and ARM940T
+ */
+
+#ifndef __ORCUS_MAILBOX_H__
+#define __ORCUS_MAILBOX_H__
+
+#include <stdint.h>
+
+/**
+   @def MAILBOX_TYPES
+   @brief Number of message types.
+
+   Number of message types which can have a handler on each CPU.
+ */
+#define MAILBOX_TYPES 16
+
+/**
+   Message handler. Called from the IRQ_DUALCPU interrupt on the receiving CPU, once per message and in the order
+   the messages were posted. Pointers from the other CPU have to be converted with importPointer().
+ */
+typedef void (*MailboxHandler)(uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+/**
+   @brief Set up the mailbox on the ARM940T.
+
+   Create the message queues in ARM940T memory, publish them to the ARM920T and start taking the interrupt raised
+   when the ARM920T posts a message. The ARM920T then calls mailboxConnect(). Set handlers with mailboxSetHandler()
+   before calling this, so no messages are missed.
+
+   @note ARM940T only
+   @note Must have called irqInit first
+   @note The message queues are allocated from the heap, which must be write-through (cacheable but not buffered,
+   see puSetDRegion) or not cached. Reading a queue cleans and invalidates the whole data cache, so the code the
+   interrupt stopped keeps any write-back data it had cached.
+
+   @return 0 if successful, non-zero if the queues could not be allocated, in which case mailboxConnect() fails 
+   straight away
+ */
+extern int mailboxInit();
+
+/**
+   @brief Connect to the mailbox on the ARM940T.
+
+   Wait for mailboxInit() to be called on the ARM940T, pick up the location of its message queues and start taking
+   the interrupt raised when the ARM940T posts a message.
+
+   @note ARM920T only
+   @note Must have called irqInit, arm940Init and arm940Run first
+
+   @param timeoutNs Nanoseconds to wait for the ARM940T
+   @return 0 if successful, non-zero if the ARM940T failed to set up the mailbox or did not do so in time
+ */
+extern int mailboxConnect(unsigned long timeoutNs);
+
+/**
+   @brief Set the handler for a message type.
+
+   Set the function called when a message of the given type arrives from the other CPU. Messages with no handler
+   are dropped.
+
+   @param type Message type (0 - MAILBOX_TYPES-1)
+   @param handler Function to call, or NULL to drop messages of this type
+ */
+extern void mailboxSetHandler(int type, MailboxHandler handler);
+
+/**
+   @brief Post a message to the other CPU.
+
+   Queue a message and interrupt the other CPU, which passes it to the handler for its type. This does not wait
+   for the message to be handled, and can be called from a message handler.
+
+   @note Memory a message refers to must be clean in the ARM920T data cache before the ARM940T reads it (see
+   cacheCleanRange).
+
+   @param type Message type (0 - MAILBOX_TYPES-1)
+   @param arg0 First argument
+   @param arg1 Second argument
+   @param arg2 Third argument
+   @return 0 if successful, non-zero if the queue is full
+ */
+extern int mailboxPost(int type, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+#endif
@@ -0,0 +1,123 @@
+/*! \file mixer.h
+    \brief Software PCM mixer
+ */
+
+#ifndef __ORCUS_MIXER_H__
+#define __ORCUS_MIXER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+   @def MIXER_VOICES
+   @brief Number of mixer voices.
+
+   Number of voices which can play at the same time.
+ */
+#define MIXER_VOICES 16
+
+/**
+   @def MIXER_UNITY
+   @brief Full volume.
+
+   Volume at which a voice plays at its original level.
+ */
+#define MIXER_UNITY 256
+
+/**
+   @def MIXER_CENTRE
+   @brief Centre pan position.
+
+   Pan position at which a voice plays at full volume on both sides.
+ */
+#define MIXER_CENTRE 128
+
+/**
+   Source sample formats, all mono and signed.
+ */
+typedef enum {
+	      /** Signed 8-bit */ MIXER_PCM8 = 0,
+	      /** Signed 16-bit */ MIXER_PCM16 = 1
+} MixerFormat;
+
+/**
+   @brief Start a voice playing.
+
+   Start playing a mono sample on a voice, replacing whatever the voice was playing. The sample data is read in place
+   so must stay valid while the voice is playing. Volume and pan are kept from the previous sample on this voice.
+
+   @param voice Voice to play on (0 - MIXER_VOICES-1)
+   @param data Sample data
+   @param length Length of the sample in samples
+   @param format Format of the sample data
+   @param loop true to repeat the sample until mixerStop() is called, false to play it once
+   @see mixerSetVolume
+ */
+extern void mixerPlay(int voice, const void* data, int length, MixerFormat format, bool loop);
+
+/**
+   @brief Stop a voice.
+
+   Stop a voice playing.
+
+   @param voice Voice to stop (0 - MIXER_VOICES-1)
+ */
+extern void mixerStop(int voice);
+
+/**
+   @brief Check if a voice is playing.
+
+   Check if a voice is playing. Voices which aren't looping stop by themselves at the end of the sample.
+
+   @param voice Voice to check (0 - MIXER_VOICES-1)
+   @return true if the voice is playing, false otherwise
+ */
+extern bool mixerIsPlaying(int voice);
+
+/**
+   @brief Set volume and pan of a voice.
+
+   Set volume and pan of a voice. Panning away from the centre reduces the volume of the other side only.
+
+   @param voice Voice to change (0 - MIXER_VOICES-1)
+   @param volume Volume (0 [silent] - MIXER_UNITY [original level], higher values amplify)
+   @param pan Pan position (0 [left] - MIXER_CENTRE - 256 [right])
+ */
+extern void mixerSetVolume(int voice, int volume, int pan);
+
+/**
+   @brief Set the sample rate of a voice.
+
+   Set the rate the sample on a voice was recorded at. Voices which don't match the output rate are resampled with 
+   linear interpolation as they are mixed. Voices default to 44100Hz and keep their rate between samples.
+
+   @param voice Voice to change (0 - MIXER_VOICES-1)
+   @param sampleRate Sample rate in Hz
+   @see mixerSetOutputRate
+ */
+extern void mixerSetRate(int voice, int sampleRate);
+
+/**
+   @brief Set the output sample rate.
+
+   Set the rate mixerRender() output is played at, which should match the rate passed to audioSetSampleRate(). 
+   Defaults to 44100Hz.
+
+   @param sampleRate Sample rate in Hz
+   @see mixerSetRate
+ */
+extern void mixerSetOutputRate(int sampleRate);
+
+/**
+   @brief Mix all playing voices.
+
+   Mix all playing voices into a buffer of 16-bit stereo PCM, saturating rather than wrapping when the sum is too
+   loud. The signature matches AudioStreamCallback, so this can be passed straight to audioStreamStart().
+
+   @param buffer Buffer to fill (aligned to a 4 byte boundary)
+   @param bytes Size of the buffer in bytes
+   @see audioStreamStart
+ */
+extern void mixerRender(void* buffer, int bytes);
+
+#endif
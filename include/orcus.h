@@ -12,16 +12,25 @@
   - \ref orcus.h "Basic GP2X initialisation"
   - \ref cachemmu.h "Caches, MMU and PU"
   - \ref timer.h "Hardware timer"
+  - \ref irq.h "Interrupts"
   - \ref uart.h "UART"
   - \ref dma.h "DMA"
   - \ref arm940.h "ARM940T"
+  - \ref ring.h "Ring buffers between CPUs"
+  - \ref mailbox.h "Messages between CPUs"
+  - \ref jobs.h "Running jobs on the ARM940T"
   - \ref sd.h "SD card"
   \section video Video
   - \ref lcd.h "LCD control"
   - \ref rgb.h "RGB layers"
   - \ref 2d.h "2D accelerator"
+  - \ref dirty.h "Dirty rectangle tracking"
+  - \ref tilemap.h "Tile map layers"
   \section audio Audio
   - \ref audio.h "AC97 codec and PCM audio"
+  - \ref mixer.h "Software PCM mixer"
+  - \ref resample.h "Sample rate conversion"
+  - \ref audio940.h "Audio mixing on the ARM940T"
 
   \section external_links Links
   - <a href="http://www.devkitpro.org/">devkitPro</a>
@@ -38,12 +47,21 @@
 #include <uart.h>
 #include <rgb.h>
 #include <2d.h>
+#include <dirty.h>
+#include <tilemap.h>
 #include <audio.h>
+#include <mixer.h>
+#include <resample.h>
+#include <audio940.h>
 #include <arm940.h>
+#include <ring.h>
+#include <mailbox.h>
+#include <jobs.h>
 #include <sd.h>
 #include <lcd.h>
 #include <dma.h>
 #include <timer.h>
+#include <irq.h>
 #include <cachemmu.h>
 
 /**
@@ -0,0 +1,52 @@
+/*! \file resample.h
+    \brief Sample rate conversion
+ */
+
+#ifndef __ORCUS_RESAMPLE_H__
+#define __ORCUS_RESAMPLE_H__
+
+#include <stdint.h>
+
+/**
+   Resampler state for a 16-bit stereo stream. Treat as opaque, set up with resamplerInit().
+ */
+typedef struct {
+  /** Input frames per output frame, 16.16 fixed point */ uint32_t step;
+  /** Position between the previous frame and the next input frame, 16.16 fixed point */ uint32_t position;
+  /** Last input frame of the previous call */ int16_t previous[2];
+} Resampler;
+
+/**
+   @brief Set up a resampler.
+
+   Set up a resampler to convert a 16-bit stereo stream from one sample rate to another with linear interpolation. 
+   This is for the output stage, e.g. a decoder producing 32kHz feeding an audio stream at 44.1kHz. To resample 
+   individual mixer voices use mixerSetRate() instead.
+
+   @param resampler Resampler to set up
+   @param inputRate Sample rate of the input in Hz
+   @param outputRate Sample rate of the output in Hz
+   @return 0 if successful, non-zero if either rate isn't positive or the input rate is more than 32768 times the 
+   output rate
+   @see resamplerProcess
+   @see mixerSetRate
+ */
+extern int resamplerInit(Resampler* resampler, int inputRate, int outputRate);
+
+/**
+   @brief Resample a block of frames.
+
+   Convert as much input as possible into output, stopping when either runs out. The resampler keeps the position and 
+   the last input frame between calls, so a stream can be fed in blocks of any size. This does not allocate memory.
+
+   @param resampler Resampler set up with resamplerInit()
+   @param input Input frames (16-bit stereo, left then right)
+   @param inputFrames Number of input frames available
+   @param output Output frames (16-bit stereo, left then right)
+   @param outputFrames Number of output frames wanted
+   @param inputUsed Set to the number of input frames used up, the rest should be passed in again next time
+   @return Number of output frames written
+ */
+extern int resamplerProcess(Resampler* resampler, const int16_t* input, int inputFrames, int16_t* output, int outputFrames, int* inputUsed);
+
+#endif
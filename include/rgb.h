@@ -117,6 +117,84 @@ extern void rgbSetScale(int srcW, int srcH);
 */
 extern void rgbSetFbAddress(void* fb);
 
+/**
+   Page flipping counters.
+ */
+typedef struct {
+  /** VSyncs since the counters were reset */ uint32_t vsyncs;
+  /** Frames put on screen */ uint32_t frames;
+  /** VSyncs where the next frame was still being drawn, so the previous one was shown again */ uint32_t missedVSyncs;
+  /** Time from rgbFlip() to the frame being put on screen, for the most recent frame */ uint32_t lastLatencyNs;
+  /** Average time from rgbFlip() to the frame being put on screen */ uint32_t averageLatencyNs;
+  /** Longest time from rgbFlip() to the frame being put on screen */ uint32_t maxLatencyNs;
+  /** Time between the two most recent frames being put on screen */ uint32_t lastFrameNs;
+} RgbFlipStats;
+
+/**
+   @brief Start vsync page flipping.
+
+   Start double (2 buffers) or triple (3 buffers) buffering. The first buffer is shown straight away, the others are 
+   handed out by rgbFlipGetBackBuffer() to be drawn into and queued with rgbFlip(). The display controller's vsync 
+   interrupt puts queued buffers on screen in order, one per vsync, so there is no tearing and no need to wait for 
+   vsync. While this is running lcdWaitNextVSync() sleeps until the interrupt rather than polling.
+
+   @note Must have called irqInit first
+   @note Buffers are read by the display controller, so any data cache lines covering them must be cleaned before 
+   rgbFlip() is called.
+
+   @param buffers Array of framebuffer pointers
+   @param count Number of buffers (2 or 3)
+   @return 0 if successful, non-zero otherwise
+   @see rgbFlipGetBackBuffer
+   @see rgbFlip
+ */
+extern int rgbFlipInit(void** buffers, int count);
+
+/**
+   @brief Stop vsync page flipping.
+
+   Stop page flipping and disable the vsync interrupt. If any frames are still queued the most recent one is put on 
+   screen.
+ */
+extern void rgbFlipStop();
+
+/**
+   @brief Get the buffer to draw the next frame into.
+
+   Get the buffer to draw the next frame into. If every buffer is either on screen or queued this sleeps until the 
+   next vsync frees one. Calling this again before rgbFlip() returns the same buffer.
+
+   @return Framebuffer to draw into, or NULL if page flipping has not been started
+   @see rgbFlip
+ */
+extern void* rgbFlipGetBackBuffer();
+
+/**
+   @brief Queue the back buffer for display.
+
+   Queue the buffer returned by rgbFlipGetBackBuffer() to be put on screen at the next free vsync. This does not wait.
+
+   @see rgbFlipGetBackBuffer
+ */
+extern void rgbFlip();
+
+/**
+   @brief Get page flipping counters.
+
+   Get page flipping counters. Useful for checking whether a renderer is keeping up with the display.
+
+   @param stats Structure to fill in
+   @see rgbFlipResetStats
+ */
+extern void rgbFlipGetStats(RgbFlipStats* stats);
+
+/**
+   @brief Reset page flipping counters.
+
+   Reset page flipping counters to zero.
+ */
+extern void rgbFlipResetStats();
+
 /**
    @brief Set region coordinates and size.
 
@@ -0,0 +1,123 @@
+/*! \file ring.h
+    \brief Ring buffers between the ARM920T and ARM940T
+ */
+
+#ifndef __ORCUS_RING_H__
+#define __ORCUS_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+   Local handle on a ring buffer. Each CPU has its own handle on the same shared memory, set up with ringInit() on 
+   one side and ringAttach() on the other. Treat as opaque.
+ */
+typedef struct {
+  /** Shared header, in this CPU's address space */ void* shared;
+  /** First entry, in this CPU's address space */ uint8_t* data;
+  /** Bytes per entry */ uint32_t entrySize;
+  /** Number of entries - 1 */ uint32_t mask;
+} RingBuffer;
+
+/**
+   @brief Get the memory needed for a ring buffer.
+
+   Get the size of shared memory needed for a ring buffer, including the header.
+
+   @param entrySize Bytes per entry (multiple of 4)
+   @param entries Number of entries (power of 2)
+   @return Bytes of memory needed
+ */
+extern uint32_t ringMemorySize(int entrySize, int entries);
+
+/**
+   @brief Create a ring buffer.
+
+   Lay out a single producer, single consumer ring buffer in shared memory. The other CPU then calls ringAttach() on 
+   the same memory. Either CPU can create the ring and either can be the producer.
+
+   Entries and the two ends of the ring are kept on separate cache lines, and the ring cleans and invalidates them 
+   as needed on the ARM920T, so the memory can be cached there. The ARM940T has no way to invalidate a single line, 
+   so on the ARM940T the ring memory must either not be cached or be write-through (cacheable but not buffered), and 
+   the whole data cache is cleaned and invalidated before reading from the ring. Dirty data elsewhere is written 
+   back rather than lost, so the rest of memory can still be write-back.
+
+   @param ring Handle to set up
+   @param memory Shared memory, ringMemorySize() bytes aligned to 32 bytes, visible to both CPUs
+   @param entrySize Bytes per entry (multiple of 4)
+   @param entries Number of entries (power of 2)
+   @return 0 if successful, non-zero otherwise
+   @see ringAttach
+ */
+extern int ringInit(RingBuffer* ring, void* memory, int entrySize, int entries);
+
+/**
+   @brief Attach to a ring buffer created by the other CPU.
+
+   Set up a handle on a ring buffer created with ringInit() on the other CPU. The memory pointer must be in this CPU's 
+   address space (see importPointer).
+
+   @param ring Handle to set up
+   @param memory Shared memory passed to ringInit() on the other CPU
+   @see ringInit
+ */
+extern void ringAttach(RingBuffer* ring, void* memory);
+
+/**
+   @brief Add entries to a ring buffer.
+
+   Copy as many entries into the ring as will fit and publish them to the consumer. Only one CPU may add entries.
+
+   @param ring Ring to add to
+   @param entries Entries to add
+   @param count Number of entries to add
+   @return Number of entries added
+ */
+extern int ringWrite(RingBuffer* ring, const void* entries, int count);
+
+/**
+   @brief Take entries from a ring buffer.
+
+   Copy up to count entries out of the ring and free their space for the producer. Only one CPU may take entries.
+
+   @param ring Ring to take from
+   @param entries Buffer to copy entries into
+   @param count Maximum number of entries to take
+   @return Number of entries taken
+ */
+extern int ringRead(RingBuffer* ring, void* entries, int count);
+
+/**
+   @brief Add an entry to a ring buffer.
+
+   Equivalent to ringWrite(ring, entry, 1).
+
+   @param ring Ring to add to
+   @param entry Entry to add
+   @return true if the entry was added, false if the ring is full
+ */
+extern bool ringPush(RingBuffer* ring, const void* entry);
+
+/**
+   @brief Take an entry from a ring buffer.
+
+   Equivalent to ringRead(ring, entry, 1).
+
+   @param ring Ring to take from
+   @param entry Buffer to copy the entry into
+   @return true if an entry was taken, false if the ring is empty
+ */
+extern bool ringPop(RingBuffer* ring, void* entry);
+
+/**
+   @brief Count entries waiting in a ring buffer.
+
+   Count entries which have been added but not yet taken. The other CPU may change this at any time, so it is only a 
+   snapshot.
+
+   @param ring Ring to check
+   @return Number of entries waiting
+ */
+extern int ringCount(RingBuffer* ring);
+
+#endif
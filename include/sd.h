@@ -7,6 +7,47 @@
 
 #include <stdint.h>
 
+/**
+   Operation carried out by an SD request.
+ */
+typedef enum {
+	      /** Read blocks from the card into the buffer */ SD_READ = 0,
+	      /** Write blocks from the buffer to the card */ SD_WRITE = 1
+} SdOperation;
+
+/**
+   State of an SD request.
+ */
+typedef enum {
+	      /** Waiting in the queue */ SD_REQUEST_QUEUED = 0,
+	      /** Currently being transferred */ SD_REQUEST_ACTIVE = 1,
+	      /** Completed successfully */ SD_REQUEST_DONE = 2,
+	      /** Completed with an error, see result */ SD_REQUEST_FAILED = 3
+} SdRequestState;
+
+typedef struct SdRequest SdRequest;
+
+/**
+   Function called when an SD request completes.
+ */
+typedef void (*SdCallback)(SdRequest* request);
+
+/**
+   Defines a queued SD transfer. The memory for a request belongs to the caller and must remain valid until it has 
+   completed.
+ */
+struct SdRequest {
+  /** Read or write */ SdOperation operation;
+  /** Block to start at (i.e. address / 512) */ int startBlock;
+  /** Number of 512B blocks to transfer */ int numberOfBlocks;
+  /** Data to write, or memory to read into */ uint8_t* buffer;
+  /** Function to call on completion (may be NULL) */ SdCallback callback;
+  /** Free for use by the caller */ void* userData;
+  /** Current state, set by the driver */ volatile SdRequestState state;
+  /** 0 if successful, non-zero otherwise, set by the driver on completion */ int result;
+  /** Used internally to link queued requests */ SdRequest* next;
+};
+
 /**
    @brief Initialise SD card.
 
@@ -16,10 +57,59 @@
  */
 extern int sdInit();
 
+/**
+   @brief Get the SD clock speed.
+
+   Get the clock speed the card is being run at. sdInit() switches cards which support it into high speed mode, then 
+   picks the fastest divider of the 74.6MHz SDI clock which gives error free reads, checked with a test read of block 0.
+   The result is remembered and reused if sdInit() is called again with the same card.
+
+   @return SD clock speed in Hz
+   @see sdInit
+   @see sdIsHighSpeed
+ */
+extern int sdClockSpeed();
+
+/**
+   @brief Check if the SD card is in high speed mode.
+
+   Check if the SD card was switched to high speed mode (up to 50MHz) by sdInit().
+
+   @return true if the card is in high speed mode, false otherwise
+ */
+extern bool sdIsHighSpeed();
+
+/**
+   @brief Get the width of the SD data bus.
+
+   Get the width of the SD data bus. sdInit() switches SD cards to a 4-bit bus, MMC cards and SD cards which refuse 
+   the switch stay on a 1-bit bus.
+
+   @return 4 if the card is using a 4-bit bus, 1 otherwise
+   @see sdInit
+ */
+extern int sdBusWidth();
+
+/**
+   @brief Use a DMA channel for SD card reads.
+
+   Use a DMA channel to move data out of the SD controller FIFO when reading, rather than having the CPU copy it a 
+   word at a time. Buffers which aren't word aligned are still copied by the CPU. The channel is reconfigured by this 
+   call and should not be used for anything else afterwards.
+
+   @param channel DMA channel to use (0 - 15), or -1 to go back to copying data with the CPU
+   @see sdReadBlocks
+ */
+extern void sdSetDmaChannel(int channel);
+
 /**
    @brief Read blocks from SD card.
 
-   Read blocks (512B) from SD card.
+   Read blocks (512B) from SD card. This queues a request and waits for it to complete.
+
+   If a DMA channel has been set with sdSetDmaChannel() and dest is aligned to a 4 byte boundary, the data is 
+   transferred by DMA. The data cache is cleaned before the transfer, and the lines covering dest are invalidated 
+   afterwards.
 
    @note Must have called sdInit first
 
@@ -29,13 +119,14 @@ extern int sdInit();
    @return 0 if successful, non-zero otherwise
 
    @see sdInit
+   @see sdSetDmaChannel
  */
 extern int sdReadBlocks(int startBlock, int numberOfBlocks, uint8_t* dest);
 
 /**
    @brief Write blocks to SD card.
 
-   Write blocks (512B) to SD card.
+   Write blocks (512B) to SD card. This queues a request and waits for it to complete.
 
    @note Must have called sdInit first
 
@@ -48,6 +139,176 @@ extern int sdReadBlocks(int startBlock, int numberOfBlocks, uint8_t* dest);
  */
 extern int sdWriteBlocks(int startBlock, int numberOfBlocks, uint8_t* src);
 
+/**
+   @brief Queue an SD transfer.
+
+   Add a request to the end of the SD queue. Requests are carried out in the order they are submitted, using CMD18 
+   (read) or CMD25 (write) for each one. Nothing happens until sdProcess() or sdWait() is called, unless interrupts
+   are in use (see sdUseInterrupts), in which case the request is started straight away if the queue is idle.
+
+   @note Must have called sdInit first
+
+   @param request Request to queue, operation, startBlock, numberOfBlocks and buffer must be filled in
+   @return 0 if the request was queued, non-zero otherwise
+
+   @see sdProcess
+   @see sdWait
+ */
+extern int sdSubmit(SdRequest* request);
+
+/**
+   @brief Advance the SD queue.
+
+   Advance the SD queue, starting queued requests and completing finished ones. Completion callbacks are called from 
+   here. This returns as soon as the request at the head of the queue is waiting on the hardware, so it should be 
+   called regularly (e.g. once per frame) while there are requests outstanding.
+
+   Reads which can use DMA (see sdSetDmaChannel) run in the background between calls. Other transfers are moved by 
+   the CPU, so a call which starts one of these does not return until it has completed.
+
+   When interrupts are in use (see sdUseInterrupts) the queue is advanced by the SD interrupt, except that a 
+   transfer the card refused to start is only retried from here or sdWait(), as recovering the card can sleep.
+
+   @warning Callbacks must not call sdWait(), sdReadBlocks() or sdWriteBlocks().
+ */
+extern void sdProcess();
+
+/**
+   @brief Drive the SD queue from interrupts.
+
+   Drive the SD queue from the SD controller interrupt rather than by polling. The FIFO is filled and drained by the 
+   interrupt handler as it crosses half full, and the data finish interrupt completes each segment and starts the 
+   next. sdWait() then sleeps the CPU until the request has finished, and transfers which don't use DMA also run in 
+   the background.
+
+   Any outstanding requests are completed before switching.
+
+   @note Must have called irqInit and sdInit first
+   @warning Completion callbacks are called from the interrupt handler when this is enabled.
+
+   @param enable true to use interrupts, false to go back to polling
+   @see sdProcess
+ */
+extern void sdUseInterrupts(bool enable);
+
+/**
+   @brief Check if the SD queue has outstanding requests.
+
+   Check if the SD queue has outstanding requests.
+
+   @return true if there are requests queued or in progress, false otherwise
+ */
+extern bool sdIsBusy();
+
+/**
+   @brief Wait for an SD request to complete.
+
+   Wait for an SD request to complete, advancing the queue until it has. When interrupts are in use (see 
+   sdUseInterrupts) the CPU sleeps between interrupts instead.
+
+   @param request Previously submitted request
+   @return 0 if successful, non-zero otherwise
+ */
+extern int sdWait(SdRequest* request);
+
+/**
+   Sector cache counters.
+ */
+typedef struct {
+  /** Sectors read from the cache */ uint32_t hits;
+  /** Sectors which had to be read from the card */ uint32_t misses;
+  /** Entries reused for a different sector */ uint32_t evictions;
+  /** Dirty sectors written back to the card */ uint32_t writeBacks;
+} SdCacheStats;
+
+/**
+   @brief Configure the sector cache.
+
+   Configure the write-back sector cache used by the SD DISC_INTERFACE (i.e. libfat). Reads and writes of up to a 
+   quarter of the cache size are served from the cache, using least recently used replacement. Larger requests go 
+   straight to the card. Any dirty sectors are written back before the cache is resized. The cache is disabled by 
+   default.
+
+   @note sdReadBlocks() and sdWriteBlocks() do not go through the cache.
+   @warning This allocates memory, sectors * 512B for data plus a small amount of bookkeeping.
+
+   @param sectors Number of 512B sectors to cache, 0 to disable the cache
+   @return 0 if successful, non-zero otherwise
+   @see sdCacheFlush
+ */
+extern int sdCacheInit(int sectors);
+
+/**
+   @brief Write back dirty sectors.
+
+   Write any dirty sectors in the sector cache back to the card. This is also done by the DISC_INTERFACE clearStatus 
+   and shutdown functions.
+
+   @return 0 if successful, non-zero otherwise
+ */
+extern int sdCacheFlush();
+
+/**
+   @brief Get sector cache counters.
+
+   Get sector cache counters, useful for picking a cache size for a given workload.
+
+   @param stats Structure to fill in
+   @see sdCacheResetStats
+ */
+extern void sdCacheGetStats(SdCacheStats* stats);
+
+/**
+   @brief Reset sector cache counters.
+
+   Reset sector cache counters to zero.
+ */
+extern void sdCacheResetStats();
+
+/**
+   Read-ahead counters.
+ */
+typedef struct {
+  /** Sectors read from the read-ahead buffers */ uint32_t hits;
+  /** Sectors which had to be read from the card */ uint32_t misses;
+  /** Sectors fetched ahead of being asked for */ uint32_t prefetched;
+} SdReadAheadStats;
+
+/**
+   @brief Configure sequential read-ahead.
+
+   Configure read-ahead for the SD DISC_INTERFACE (i.e. libfat). When a read carries on from where the previous one 
+   finished, the driver fills a window of the given size starting at that sector, and queues the following window 
+   straight away so that it can load in the background. Subsequent sequential reads are then copied out of RAM. Reads 
+   of at least the window size skip read-ahead entirely. Read-ahead is disabled by default.
+
+   @note The next window only loads in the background if reads use DMA (see sdSetDmaChannel) or interrupts (see 
+   sdUseInterrupts). When polling, sdProcess() must also be called while the caller is busy with other work.
+   @warning This allocates 2 * sectors * 512B of memory.
+
+   @param sectors Size of the read-ahead window in 512B sectors, 0 to disable read-ahead
+   @return 0 if successful, non-zero otherwise
+   @see sdReadAheadGetStats
+ */
+extern int sdSetReadAhead(int sectors);
+
+/**
+   @brief Get read-ahead counters.
+
+   Get read-ahead counters. The hit rate is hits / (hits + misses).
+
+   @param stats Structure to fill in
+   @see sdReadAheadResetStats
+ */
+extern void sdReadAheadGetStats(SdReadAheadStats* stats);
+
+/**
+   @brief Reset read-ahead counters.
+
+   Reset read-ahead counters to zero.
+ */
+extern void sdReadAheadResetStats();
+
 /**
    @brief Check if SD card is inserted.
 
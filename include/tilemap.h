@@ -0,0 +1,126 @@
+/*! \file tilemap.h
+    \brief Tile map layers drawn with the 2D accelerator
+ */
+
+#ifndef __ORCUS_TILEMAP_H__
+#define __ORCUS_TILEMAP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <2d.h>
+
+/**
+   A scrolling tile map layer. Tiles are drawn once into an off-screen cache which wraps around in both directions,
+   so scrolling only draws the newly exposed columns and rows of tiles and the rest of the view is copied from the
+   cache. Treat as opaque.
+ */
+typedef struct {
+  /** Graphic holding the tiles, left to right then top to bottom */ Graphic* tileset;
+  /** Width in pixels of a tile */ int tileW;
+  /** Height in pixels of a tile */ int tileH;
+  /** Tile numbers, mapW*mapH of them row by row */ uint16_t* tiles;
+  /** Width in tiles of the map */ int mapW;
+  /** Height in tiles of the map */ int mapH;
+  /** Width in pixels of the view */ int viewW;
+  /** Height in pixels of the view */ int viewH;
+  /** X-coordinate in the map of the left edge of the view */ int scrollX;
+  /** Y-coordinate in the map of the top edge of the view */ int scrollY;
+  /** Off-screen copy of the tiles around the view */ Graphic cache;
+  /** Width in tiles of the cache */ int cacheCols;
+  /** Height in tiles of the cache */ int cacheRows;
+  /** First map column and row in the cache */ int cachedCol, cachedRow;
+  /** Last map column and row in the cache */ int cachedLastCol, cachedLastRow;
+  /** The cached columns and rows are valid if true */ bool cacheValid;
+  /** Operations waiting to run */ RasterList list;
+  /** The list has been submitted if true */ bool submitted;
+} TileMap;
+
+/**
+   @brief Set up a tile map layer.
+
+   Set up a tile map layer and allocate its cache, which is a little more than the size of the view in the format of
+   the tile set. The map has to be at least as big as the view.
+
+   @param map Tile map to set up
+   @param tileset Graphic holding the tiles, in P8BPP or RGB565 format
+   @param tileW Width in pixels of a tile
+   @param tileH Height in pixels of a tile
+   @param tiles Tile numbers, mapW*mapH of them row by row, kept by the layer rather than copied
+   @param mapW Width in tiles of the map
+   @param mapH Height in tiles of the map
+   @param viewW Width in pixels of the area drawn
+   @param viewH Height in pixels of the area drawn
+   @return 0 if successful, non-zero if the arguments are invalid or out of memory
+ */
+extern int tileMapInit(TileMap* map, Graphic* tileset, int tileW, int tileH, uint16_t* tiles, int mapW, int mapH, int viewW, int viewH);
+
+/**
+   @brief Free a tile map layer.
+
+   Wait for the layer to finish drawing and free its cache. The tile numbers and tile set are left alone.
+
+   @param map Tile map to free
+ */
+extern void tileMapFree(TileMap* map);
+
+/**
+   @brief Scroll a tile map layer.
+
+   Set the position in the map of the top left of the view, in pixels. The position is kept within the map.
+
+   @param map Tile map to scroll
+   @param x X-coordinate in the map
+   @param y Y-coordinate in the map
+ */
+extern void tileMapScroll(TileMap* map, int x, int y);
+
+/**
+   @brief Change a tile.
+
+   Change one tile in the map, redrawing it in the cache if it is there.
+
+   @param map Tile map to change
+   @param col Column of the tile
+   @param row Row of the tile
+   @param tile New tile number
+ */
+extern void tileMapSetTile(TileMap* map, int col, int row, uint16_t tile);
+
+/**
+   @brief Redraw a whole tile map layer.
+
+   Throw away the cache so every visible tile is drawn again next time, e.g. after changing the tile numbers or tile
+   set directly.
+
+   @param map Tile map to redraw
+ */
+extern void tileMapInvalidate(TileMap* map);
+
+/**
+   @brief Draw a tile map layer.
+
+   Draw the visible part of the map onto a destination graphic, usually the back buffer. Newly exposed tiles are
+   drawn into the cache, then the view is copied from the cache with at most four blits. This starts the 2D
+   accelerator and returns without waiting for it, the layer uses a raster list of its own.
+
+   @note The view must fit within the destination, and the destination must be in the same format as the tile set.
+   @warning Don't use the other raster functions until the layer has been drawn.
+
+   @param map Tile map to draw
+   @param dest Destination graphic to draw onto
+   @param x X-coordinate on the destination of the top left of the view
+   @param y Y-coordinate on the destination of the top left of the view
+   @see tileMapWait
+ */
+extern void tileMapDraw(TileMap* map, Graphic* dest, int x, int y);
+
+/**
+   @brief Wait for a tile map layer to be drawn.
+
+   Wait until the 2D accelerator has finished drawing a tile map layer.
+
+   @param map Tile map to wait for
+ */
+extern void tileMapWait(TileMap* map);
+
+#endif
@@ -2,6 +2,7 @@
 #include <orcus.h>
 #include <2d.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #define FRAC_16BPP(x) ((x%2)*16)
 #define FRAC_8BPP(x) ((x%4)*8)
@@ -12,6 +13,8 @@
   FRAC_1BPP(x) \
 )
 
+#define SPRITE_BATCH 64
+
 static uint16_t transparencyColour = 0xF81F;
 
 volatile uint32_t* pattern = (r32) (((uint32_t)&__io_base)+0x20000000+PAT);
@@ -32,54 +35,78 @@ void rgbPatternFill(Graphic* dest, Rect* region, RasterPattern* pattern, bool en
   rgbRasterOp(NULL, NULL, dest, region, ROP_PATCOPY, pattern, enableTransparency, 0, 0);
 }
 
-void rgbRasterOp(Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uint8_t rasterOp, RasterPattern* pattern, bool enableTransparency, uint16_t srcFgCol, uint16_t srcBgCol) {
+/*
+  A raster operation is worked out into the values for each register first, so operations can either be loaded
+  straight away or recorded into a list and loaded later.
+*/
+typedef struct {
+  uint32_t dstCtrl;
+  uint32_t dstAddr;
+  uint32_t dstStride;
+  uint32_t srcCtrl;
+  uint32_t srcAddr;
+  uint32_t srcStride;
+  uint32_t srcFgCol;
+  uint32_t srcBgCol;
+  uint32_t size;
+  uint32_t patCtrl;
+  uint32_t patFgCol;
+  uint32_t patBgCol;
+  uint32_t ctrl;
+} RasterCommand;
+
+static void rgb_setupOp(RasterCommand* cmd, Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uint8_t rasterOp, RasterPattern* pattern, bool enableTransparency, uint16_t srcFgCol, uint16_t srcBgCol) {
   int destBpp = dest->format == P8BPP ? 1 : 2;
   unsigned int destStride = dest->w*destBpp;
   uint32_t destAddress = ((uint32_t)((destRect->y*destStride+(destRect->x*destBpp)) + ((uint8_t*)dest->data))) & ~0x3;
 
-  FREG32(DSTCTRL) = (dest->format == P8BPP ? 0 : BIT(5))
+  cmd->dstCtrl = (dest->format == P8BPP ? 0 : BIT(5))
     | FRAC(dest->format, destRect->x);
-  FREG32(DSTADDR) = destAddress;
-  FREG32(DSTSTRIDE) = destStride;
+  cmd->dstAddr = destAddress;
+  cmd->dstStride = destStride;
 
   if(src == NULL) {
-    FREG32(SRCCTRL) = 0x0;
-    FREG32(SRCADDR) = 0x0;
-    FREG32(SRCSTRIDE) = 0x0;
+    cmd->srcCtrl = 0x0;
+    cmd->srcAddr = 0x0;
+    cmd->srcStride = 0x0;
+    cmd->srcFgCol = 0x0;
+    cmd->srcBgCol = 0x0;
   } else {
     int sourceBpp = src->format == RGB565 ? 2 : 1;
     unsigned int sourceStride = src->format == B1BPP ? 1 : src->w*sourceBpp;
     uint32_t sourceAddress = ((uint32_t)((srcRect->y*sourceStride+(srcRect->x*sourceBpp)) + ((uint8_t*)src->data))) & ~0x3;
 
-    FREG32(SRCFORCOLOR) = src->format == B1BPP ? srcFgCol : 0;
-    FREG32(SRCBACKCOLOR) = src->format == B1BPP ? srcBgCol : 0;
+    cmd->srcFgCol = src->format == B1BPP ? srcFgCol : 0;
+    cmd->srcBgCol = src->format == B1BPP ? srcBgCol : 0;
     
-    FREG32(SRCCTRL) = BIT(8)
+    cmd->srcCtrl = BIT(8)
       | BIT(7)
       | ((src->format == P8BPP ? 0 : src->format == RGB565 ? 1 : 2) << 5)
       | FRAC(src->format, srcRect->x);
-    FREG32(SRCADDR) = sourceAddress;
-    FREG32(SRCSTRIDE) = sourceStride;
+    cmd->srcAddr = sourceAddress;
+    cmd->srcStride = sourceStride;
   }
 
   unsigned int szX = destRect->w & 0x7FF;
   unsigned int szY = destRect->h & 0x7FF;
-  FREG32(SIZE) = (szY<<16) | szX;
+  cmd->size = (szY<<16) | szX;
 
   if(pattern == NULL) {
-    FREG32(PATCTRL) = 0x0;
+    cmd->patCtrl = 0x0;
+    cmd->patFgCol = 0x0;
+    cmd->patBgCol = 0x0;
   } else {
-    FREG32(PATCTRL) = (pattern->format == B1BPP ? 0 : BIT(6))
+    cmd->patCtrl = (pattern->format == B1BPP ? 0 : BIT(6))
       | BIT(5) // if you passed a pattern we can assume we want to enable it
       | ((pattern->format == P8BPP ? 0 :
 	 pattern->format == RGB565 ? 1 :
 	 pattern->format == B1BPP ? 2 : 3) << 3)
       | pattern->yOffset;
-    FREG32(PATFORCOLOR) = pattern->fgCol;
-    FREG32(PATBACKCOLOR) = pattern->bgCol;
+    cmd->patFgCol = pattern->fgCol;
+    cmd->patBgCol = pattern->bgCol;
   }
 
-  FREG32(CTRL) = (((uint32_t)transparencyColour) << 16)
+  cmd->ctrl = (((uint32_t)transparencyColour) << 16)
     | ((dest->format == RGB565 && enableTransparency) ? BIT(11) : 0)
     | BIT(10)
     | BIT(9)
@@ -87,23 +114,340 @@ void rgbRasterOp(Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uin
     | rasterOp;
 }
 
+/*
+  The accelerator keeps its registers between operations, and consecutive operations (e.g. tiles from one tile set
+  onto one screen) mostly share strides, formats, colours and the raster op. A copy of what was last written is
+  kept so that only the registers which change are written - FPGA register writes are slow compared to comparing
+  two words.
+*/
+static RasterCommand shadow;
+static bool shadowValid = false;
+
+static inline void rgb_loadReg(uint32_t reg, uint32_t* shadowValue, uint32_t value) {
+  if(!shadowValid || *shadowValue != value) {
+    FREG32(reg) = value;
+    *shadowValue = value;
+  }
+}
+
+static void rgb_loadOp(const RasterCommand* cmd) {
+  rgb_loadReg(DSTCTRL, &shadow.dstCtrl, cmd->dstCtrl);
+  rgb_loadReg(DSTADDR, &shadow.dstAddr, cmd->dstAddr);
+  rgb_loadReg(DSTSTRIDE, &shadow.dstStride, cmd->dstStride);
+  // the colours are left alone when there is no source or pattern to use them, as they always have been
+  if(cmd->srcCtrl != 0) {
+    rgb_loadReg(SRCFORCOLOR, &shadow.srcFgCol, cmd->srcFgCol);
+    rgb_loadReg(SRCBACKCOLOR, &shadow.srcBgCol, cmd->srcBgCol);
+  }
+  rgb_loadReg(SRCCTRL, &shadow.srcCtrl, cmd->srcCtrl);
+  rgb_loadReg(SRCADDR, &shadow.srcAddr, cmd->srcAddr);
+  rgb_loadReg(SRCSTRIDE, &shadow.srcStride, cmd->srcStride);
+  rgb_loadReg(SIZE, &shadow.size, cmd->size);
+  rgb_loadReg(PATCTRL, &shadow.patCtrl, cmd->patCtrl);
+  if(cmd->patCtrl != 0) {
+    rgb_loadReg(PATFORCOLOR, &shadow.patFgCol, cmd->patFgCol);
+    rgb_loadReg(PATBACKCOLOR, &shadow.patBgCol, cmd->patBgCol);
+  }
+  rgb_loadReg(CTRL, &shadow.ctrl, cmd->ctrl);
+  shadowValid = true;
+}
+
+void rgbRasterForgetState() {
+  shadowValid = false;
+}
+
+void rgbRasterOp(Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uint8_t rasterOp, RasterPattern* pattern, bool enableTransparency, uint16_t srcFgCol, uint16_t srcBgCol) {
+  RasterCommand cmd;
+  rgb_setupOp(&cmd, src, srcRect, dest, destRect, rasterOp, pattern, enableTransparency, srcFgCol, srcBgCol);
+  rgb_loadOp(&cmd);
+}
+
 // only valid when dest is rgb565
 void rgbSetTransparencyColour(uint16_t colour) {
   transparencyColour = colour;
 }
 
 void rgbRasterRun() {
-  FREG32(RUN) |= BIT(0);
+  FREG32(RUN) = RUN_START;
 }
 
 bool rgbRasterIsRunning() {
-  return FREG32(RUN) & BIT(0);
+  return FREG32(RUN) & RUN_START;
 }
 
 void rgbRasterWaitComplete() {
   while(rgbRasterIsRunning());
 }
 
+static inline int rgb_max(int a, int b) {
+  return a > b ? a : b;
+}
+
+static inline int rgb_min(int a, int b) {
+  return a < b ? a : b;
+}
+
+/*
+  Raster lists
+
+  One list runs at a time. Each time the accelerator finishes an operation the next one is loaded and started,
+  either from the GRP2D interrupt or, without interrupts, whenever the list is polled.
+*/
+static RasterList* volatile activeList = NULL;
+static bool useInterrupts = false;
+
+static inline RasterCommand* rgb_listCommands(RasterList* list) {
+  return (RasterCommand*) list->commands;
+}
+
+// start the next operation in the active list, or retire the list when there are none left
+static void rgb_listNext() {
+  RasterList* list = activeList;
+  if(list->next < list->count) {
+    rgb_loadOp(&rgb_listCommands(list)[list->next++]);
+    rgbRasterRun();
+  } else {
+    activeList = NULL;
+  }
+}
+
+static void rgb_rasterIrqHandler() {
+  FREG32(RUN) = RUN_INTR;
+  if(activeList != NULL) {
+    rgb_listNext();
+  }
+}
+
+void rgbRasterUseInterrupts(bool enable) {
+  while(activeList != NULL) {
+    rgbListProcess();
+  }
+
+  if(enable) {
+    irqSetHandler(IRQ_GRP2D, rgb_rasterIrqHandler);
+    FREG32(RUN) = RUN_INTR;
+    useInterrupts = true;
+    irqEnable(IRQ_GRP2D);
+  } else {
+    irqDisable(IRQ_GRP2D);
+    useInterrupts = false;
+  }
+}
+
+int rgbListInit(RasterList* list, int capacity) {
+  list->commands = malloc(capacity*sizeof(RasterCommand));
+  list->capacity = list->commands == NULL ? 0 : capacity;
+  list->count = 0;
+  list->next = 0;
+  list->clipped = false;
+  return list->commands == NULL ? 1 : 0;
+}
+
+void rgbListFree(RasterList* list) {
+  rgbListWait(list);
+  free(list->commands);
+  list->commands = NULL;
+  list->capacity = 0;
+  list->count = 0;
+}
+
+void rgbListClear(RasterList* list) {
+  rgbListWait(list);
+  list->count = 0;
+}
+
+void rgbListSetClip(RasterList* list, const Rect* clip) {
+  list->clipped = clip != NULL;
+  if(clip != NULL) {
+    list->clip = *clip;
+  }
+}
+
+int rgbListRasterOp(RasterList* list, Graphic* src, Rect* srcRect, Graphic* dest, Rect* destRect, uint8_t rasterOp, RasterPattern* pattern, bool enableTransparency, uint16_t srcFgCol, uint16_t srcBgCol) {
+  Rect clippedDest;
+  Rect clippedSrc;
+  RasterPattern clippedPattern;
+
+  if(list->clipped) {
+    int dx = rgb_max(list->clip.x - destRect->x, 0);
+    int dy = rgb_max(list->clip.y - destRect->y, 0);
+    int w = rgb_min(destRect->x + destRect->w, list->clip.x + list->clip.w) - (destRect->x + dx);
+    int h = rgb_min(destRect->y + destRect->h, list->clip.y + list->clip.h) - (destRect->y + dy);
+    if(w <= 0 || h <= 0) {
+      return 0;
+    }
+
+    clippedDest = (Rect){destRect->x + dx, destRect->y + dy, w, h};
+    destRect = &clippedDest;
+    if(srcRect != NULL) {
+      clippedSrc = (Rect){srcRect->x + dx, srcRect->y + dy, w, h};
+      srcRect = &clippedSrc;
+    }
+    if(pattern != NULL && dy != 0) {
+      clippedPattern = *pattern;
+      clippedPattern.yOffset = (pattern->yOffset + dy) & 0x7;
+      pattern = &clippedPattern;
+    }
+  }
+
+  if(list->count >= list->capacity) {
+    return 1;
+  }
+  rgb_setupOp(&rgb_listCommands(list)[list->count++], src, srcRect, dest, destRect, rasterOp, pattern, enableTransparency, srcFgCol, srcBgCol);
+  return 0;
+}
+
+int rgbListBlit(RasterList* list, Graphic* src, Rect* srcRect, Graphic* dest, int x, int y, bool enableTransparency) {
+  return rgbListRasterOp(list, src, srcRect, dest, &((Rect){x, y, srcRect->w, srcRect->h}), ROP_SRCCOPY, NULL, enableTransparency, 0, 0);
+}
+
+int rgbListSolidFill(RasterList* list, Graphic* dest, Rect* region, uint16_t colour) {
+  return rgbListRasterOp(list, NULL, NULL, dest, region, ROP_PATCOPY, &((RasterPattern){colour, colour, B1BPP, 0}), false, 0, 0);
+}
+
+int rgbListPatternFill(RasterList* list, Graphic* dest, Rect* region, RasterPattern* pattern, bool enableTransparency) {
+  return rgbListRasterOp(list, NULL, NULL, dest, region, ROP_PATCOPY, pattern, enableTransparency, 0, 0);
+}
+
+void rgbListSubmit(RasterList* list) {
+  while(activeList != NULL) {
+    rgbListWait(activeList);
+  }
+  if(list->count == 0) {
+    return;
+  }
+
+  uint32_t state = irqSuspend();
+  list->next = 0;
+  activeList = list;
+  rgb_listNext();
+  irqResume(state);
+}
+
+bool rgbListIsRunning(RasterList* list) {
+  return activeList == list;
+}
+
+void rgbListProcess() {
+  if(!useInterrupts) {
+    while(activeList != NULL && !rgbRasterIsRunning()) {
+      rgb_listNext();
+    }
+  }
+}
+
+void rgbListWait(RasterList* list) {
+  while(activeList == list) {
+    if(useInterrupts) {
+      // check again with IRQs off so the last operation can't finish between the check and the wait
+      uint32_t state = irqSuspend();
+      if(activeList == list) {
+	irqWaitForInterrupt();
+      }
+      irqResume(state);
+    } else {
+      rgbListProcess();
+    }
+  }
+}
+
+/*
+  Sprites are all blits onto the same destination, so the destination side of the registers is worked out once per
+  batch and the source side once per run of sprites from the same graphic, leaving only the addresses per sprite.
+*/
+int rgbListSprites(RasterList* list, const Sprite* sprites, int count, Graphic* dest, const Rect* clip) {
+  int left = clip == NULL ? 0 : rgb_max(clip->x, 0);
+  int top = clip == NULL ? 0 : rgb_max(clip->y, 0);
+  int right = clip == NULL ? dest->w : rgb_min(clip->x + clip->w, dest->w);
+  int bottom = clip == NULL ? dest->h : rgb_min(clip->y + clip->h, dest->h);
+  if(list->clipped) {
+    left = rgb_max(left, list->clip.x);
+    top = rgb_max(top, list->clip.y);
+    right = rgb_min(right, list->clip.x + list->clip.w);
+    bottom = rgb_min(bottom, list->clip.y + list->clip.h);
+  }
+
+  int destBpp = dest->format == P8BPP ? 1 : 2;
+  unsigned int destStride = dest->w*destBpp;
+  uint32_t ctrl = (((uint32_t)transparencyColour) << 16) | BIT(10) | BIT(9) | BIT(8) | ROP_SRCCOPY;
+  uint32_t transparentCtrl = ctrl | (dest->format == RGB565 ? BIT(11) : 0);
+
+  const Graphic* src = NULL;
+  int sourceBpp = 0;
+  unsigned int sourceStride = 0;
+  uint32_t srcCtrl = 0;
+
+  int i;
+  for(i = 0 ; i < count ; i++) {
+    const Sprite* sprite = &sprites[i];
+    int x = sprite->x;
+    int y = sprite->y;
+    int sx = sprite->srcRect.x;
+    int sy = sprite->srcRect.y;
+    int w = sprite->srcRect.w;
+    int h = sprite->srcRect.h;
+
+    if(x < left) {
+      sx += left - x;
+      w -= left - x;
+      x = left;
+    }
+    if(y < top) {
+      sy += top - y;
+      h -= top - y;
+      y = top;
+    }
+    w = rgb_min(w, right - x);
+    h = rgb_min(h, bottom - y);
+    if(w <= 0 || h <= 0) {
+      continue;
+    }
+
+    if(list->count >= list->capacity) {
+      break;
+    }
+
+    if(sprite->src != src) {
+      src = sprite->src;
+      sourceBpp = src->format == RGB565 ? 2 : 1;
+      sourceStride = src->format == B1BPP ? 1 : src->w*sourceBpp;
+      srcCtrl = BIT(8) | BIT(7) | ((src->format == P8BPP ? 0 : src->format == RGB565 ? 1 : 2) << 5);
+    }
+
+    RasterCommand* cmd = &rgb_listCommands(list)[list->count++];
+    cmd->dstCtrl = (dest->format == P8BPP ? 0 : BIT(5)) | FRAC(dest->format, x);
+    cmd->dstAddr = ((uint32_t)((y*destStride+(x*destBpp)) + ((uint8_t*)dest->data))) & ~0x3;
+    cmd->dstStride = destStride;
+    cmd->srcCtrl = srcCtrl | FRAC(src->format, sx);
+    cmd->srcAddr = ((uint32_t)((sy*sourceStride+(sx*sourceBpp)) + ((uint8_t*)src->data))) & ~0x3;
+    cmd->srcStride = sourceStride;
+    cmd->srcFgCol = 0x0;
+    cmd->srcBgCol = 0x0;
+    cmd->size = ((h & 0x7FF) << 16) | (w & 0x7FF);
+    cmd->patCtrl = 0x0;
+    cmd->patFgCol = 0x0;
+    cmd->patBgCol = 0x0;
+    cmd->ctrl = sprite->transparent ? transparentCtrl : ctrl;
+  }
+  return i;
+}
+
+void rgbDrawSprites(const Sprite* sprites, int count, Graphic* dest, const Rect* clip) {
+  RasterList list;
+  if(rgbListInit(&list, SPRITE_BATCH)) {
+    return;
+  }
+
+  while(count > 0) {
+    int done = rgbListSprites(&list, sprites, count, dest, clip);
+    rgbListSubmit(&list);
+    rgbListClear(&list); // waits for the batch, the list is reused for the next one
+    sprites += done;
+    count -= done;
+  }
+  rgbListFree(&list);
+}
+
 // x,y is top left corner of destination
 void rgbRotBlit(Graphic* src, Rect* srcRect, Graphic* dest, int x, int y, Angle angle) {
   int sourceBpp = src->format == P8BPP ? 0 :
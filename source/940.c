@@ -1,5 +1,6 @@
 #include <gp2xregs.h>
 #include <orcus.h>
+#include <stddef.h>
 
 volatile uint16_t* arm920Data = (r16) (((uint32_t)&__io_base)+DUAL920DAT0);
 volatile uint16_t* arm940Data = (r16) (((uint32_t)&__io_base)+DUAL940DAT0);
@@ -7,6 +8,13 @@ volatile uint16_t* arm940Data = (r16) (((uint32_t)&__io_base)+DUAL940DAT0);
 extern void* __is_arm940;
 extern void* __arm940_bank;
 
+/*
+  Each CPU can be interrupted when the other writes to one of its data registers (arm920Data for the ARM920T,
+  arm940Data for the ARM940T), with one enable and one pending bit per register. Both CPUs share the IRQ_DUALCPU
+  source, so this keeps a handler per register and dispatches from a single interrupt handler.
+*/
+static IrqHandler dataHandlers[16];
+
 bool arm940Running() {
   return !(REG16(DUALCTRL940) & BIT(7));
 }
@@ -42,10 +50,47 @@ int arm940Init(int memoryBank) {
   arm940ClockOn();
   REG16(DUALINT920) = 0x0;
   REG16(DUALINT940) = 0x0;
+  for(int i = 0 ; i < 16 ; i++) {
+    arm920Data[i] = 0x0;
+    arm940Data[i] = 0x0;
+  }
 
   return 0;
 }
 
+static void orcus_dualIrqHandler() {
+  uint32_t pendReg = arm940IsThis() ? DUALPEND940 : DUALPEND920;
+  uint32_t intReg = arm940IsThis() ? DUALINT940 : DUALINT920;
+  uint16_t pending = REG16(pendReg) & REG16(intReg);
+
+  for(int i = 0 ; pending ; i++, pending >>= 1) {
+    if(pending & 0x1) {
+      // clear first, so a write made while the handler runs raises the interrupt again
+      REG16(pendReg) = BIT(i);
+      if(dataHandlers[i] != NULL) {
+	dataHandlers[i]();
+      }
+    }
+  }
+}
+
+void arm940SetDataHandler(int reg, IrqHandler handler) {
+  uint32_t pendReg = arm940IsThis() ? DUALPEND940 : DUALPEND920;
+  uint32_t intReg = arm940IsThis() ? DUALINT940 : DUALINT920;
+
+  uint32_t state = irqSuspendAll();
+  irqSetHandler(IRQ_DUALCPU, orcus_dualIrqHandler);
+  dataHandlers[reg] = handler;
+  if(handler != NULL) {
+    REG16(pendReg) = BIT(reg);
+    REG16(intReg) |= BIT(reg);
+    irqEnable(IRQ_DUALCPU);
+  } else {
+    REG16(intReg) &= ~BIT(reg);
+  }
+  irqResume(state);
+}
+
 bool arm940IsThis() {
   uint32_t idCode;
   asm volatile("mrc p15, 0, %[idCode], c0, c0, 0"
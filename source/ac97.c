@@ -1,5 +1,6 @@
 #include <gp2xregs.h>
 #include <orcus.h>
+#include <malloc.h>
 
 #define SPDIF_CONFIG 0x2A
 #define DACSR 0x2C
@@ -10,8 +11,6 @@
 #define SPKOUT 0x02
 #define HPOUT 0x04
 
-#define AUDIO_BASE 0xC0000E00
-
 static int audioDmaChannel = 0;
 static bool isF200;
 
@@ -113,3 +112,74 @@ bool audioSamplePlaying() {
 bool audioHeadphonesConnected() {
   return isF200 ? false : !(REG16(GPIOLPINLVL) & BIT(11));
 }
+
+/*
+  Streaming
+
+  A ring of buffers played back to back. The DMA finished interrupt starts the next buffer before anything else, then
+  refills the one which just finished - it is the furthest from being played again, so the callback gets
+  (buffers - 1) buffers worth of time to produce it.
+*/
+static uint8_t* streamData = NULL;
+static int streamBuffers = 0;
+static int streamBufferBytes;
+static volatile int streamPlaying;
+static AudioStreamCallback streamCallback;
+
+static inline uint8_t* audio_streamBuffer(int idx) {
+  return streamData + (idx*streamBufferBytes);
+}
+
+static void audio_fillBuffer(int idx) {
+  streamCallback(audio_streamBuffer(idx), streamBufferBytes);
+  // the DMA controller reads from memory, so anything written through the data cache has to be written back first
+  cacheCleanRange(audio_streamBuffer(idx), streamBufferBytes);
+}
+
+static void audio_streamFinished(int channel) {
+  int finished = streamPlaying;
+  streamPlaying = (streamPlaying + 1) % streamBuffers;
+  dmaStart(audioDmaChannel, streamBufferBytes, (uint32_t)audio_streamBuffer(streamPlaying), AUDIO_BASE);
+  audio_fillBuffer(finished);
+}
+
+int audioStreamStart(int buffers, int bufferBytes, AudioStreamCallback callback) {
+  audioStreamStop();
+
+  if(buffers < 2 || bufferBytes <= 0 || bufferBytes > 0xFFF0 || (bufferBytes & 0xF) || callback == NULL) {
+    return 1;
+  }
+
+  streamData = (uint8_t*) memalign(32, buffers*bufferBytes);
+  if(streamData == NULL) {
+    return 2;
+  }
+  streamBuffers = buffers;
+  streamBufferBytes = bufferBytes;
+  streamCallback = callback;
+
+  for(int i = 0 ; i < buffers ; i++) {
+    audio_fillBuffer(i);
+  }
+
+  streamPlaying = 0;
+  dmaSetFinishedHandler(audioDmaChannel, audio_streamFinished);
+  dmaStart(audioDmaChannel, streamBufferBytes, (uint32_t)audio_streamBuffer(0), AUDIO_BASE);
+  return 0;
+}
+
+void audioStreamStop() {
+  if(streamBuffers == 0) {
+    return;
+  }
+
+  dmaSetFinishedHandler(audioDmaChannel, NULL);
+  dmaStop(audioDmaChannel);
+  free(streamData);
+  streamData = NULL;
+  streamBuffers = 0;
+}
+
+bool audioStreamIsRunning() {
+  return streamBuffers > 0;
+}
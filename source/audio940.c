@@ -0,0 +1,171 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <malloc.h>
+
+/*
+  Commands go through a ring buffer in ARM940T memory. The data registers carry the location of the ring and status
+  back from the ARM940T, and a doorbell so the ARM940T only looks at the ring (which means cleaning and invalidating
+  its whole data cache) when something has been posted.
+
+  arm940Data (written by the ARM920T)
+  0 - doorbell, incremented after each command is posted
+
+  arm920Data (written by the ARM940T)
+  0 - SERVICE_READY once the service is running, or SERVICE_FAILED if it couldn't allocate its memory
+  1 - command ring address low
+  2 - command ring address high
+  3 - voices playing, one bit per voice
+*/
+#define SERVICE_READY 0xA940
+#define SERVICE_FAILED 0xA94F
+#define QUEUE_LENGTH 64
+#define COMMAND_BATCH 8
+
+#define REG_DOORBELL 0
+#define REG_READY 0
+#define REG_QUEUE_LOW 1
+#define REG_QUEUE_HIGH 2
+#define REG_PLAYING 3
+
+typedef enum {
+	      COMMAND_PLAY,
+	      COMMAND_STOP,
+	      COMMAND_VOLUME,
+	      COMMAND_RATE,
+	      COMMAND_OUTPUT_RATE
+} CommandType;
+
+typedef struct {
+  uint16_t type;
+  uint16_t voice;
+  uint32_t args[3];
+} Audio940Command;
+
+static RingBuffer commandRing;
+
+// ARM940T
+
+static void audio940_carryOut(Audio940Command* command) {
+  switch(command->type) {
+  case COMMAND_PLAY:
+    mixerPlay(command->voice, importPointer(command->args[0]), command->args[1], command->args[2] & 0xFF, command->args[2] >> 8);
+    break;
+  case COMMAND_STOP:
+    mixerStop(command->voice);
+    break;
+  case COMMAND_VOLUME:
+    mixerSetVolume(command->voice, command->args[0], command->args[1]);
+    break;
+  case COMMAND_RATE:
+    mixerSetRate(command->voice, command->args[0]);
+    break;
+  case COMMAND_OUTPUT_RATE:
+    mixerSetOutputRate(command->args[0]);
+    break;
+  }
+}
+
+static uint16_t audio940_playingVoices() {
+  uint16_t playing = 0;
+  for(int i = 0 ; i < MIXER_VOICES ; i++) {
+    playing |= mixerIsPlaying(i) ? BIT(i) : 0;
+  }
+  return playing;
+}
+
+int audio940Service(int dmaChannel, int buffers, int bufferBytes) {
+  uint8_t* data = (uint8_t*) memalign(32, buffers*bufferBytes);
+  void* ringMemory = memalign(32, ringMemorySize(sizeof(Audio940Command), QUEUE_LENGTH));
+  if(data == NULL || ringMemory == NULL) {
+    free(data);
+    free(ringMemory);
+    arm920Data[REG_READY] = SERVICE_FAILED;
+    return 1;
+  }
+  ringInit(&commandRing, ringMemory, sizeof(Audio940Command), QUEUE_LENGTH);
+
+  for(int i = 0 ; i < buffers ; i++) {
+    mixerRender(data + (i*bufferBytes), bufferBytes);
+  }
+  cacheDrainWriteBuffer();
+
+  uint16_t doorbell = arm940Data[REG_DOORBELL];
+  uint32_t ringAddr = (uint32_t)ringMemory; // the ARM920T imports it
+  arm920Data[REG_PLAYING] = 0;
+  arm920Data[REG_QUEUE_LOW] = ringAddr & 0xFFFF;
+  arm920Data[REG_QUEUE_HIGH] = ringAddr >> 16;
+  arm920Data[REG_READY] = SERVICE_READY;
+
+  int playing = 0;
+  dmaStart(dmaChannel, bufferBytes, exportPointer(data), AUDIO_BASE);
+
+  while(1) {
+    if(arm940Data[REG_DOORBELL] != doorbell) {
+      doorbell = arm940Data[REG_DOORBELL];
+      Audio940Command commands[COMMAND_BATCH];
+      for(int count ; (count = ringRead(&commandRing, commands, COMMAND_BATCH)) > 0 ; ) {
+	for(int i = 0 ; i < count ; i++) {
+	  audio940_carryOut(&commands[i]);
+	}
+      }
+    }
+
+    if(dmaHasFinished(dmaChannel)) {
+      int finished = playing;
+      playing = (playing + 1) % buffers;
+      dmaStart(dmaChannel, bufferBytes, exportPointer(data + (playing*bufferBytes)), AUDIO_BASE);
+
+      mixerRender(data + (finished*bufferBytes), bufferBytes);
+      cacheDrainWriteBuffer();
+      arm920Data[REG_PLAYING] = audio940_playingVoices();
+    }
+  }
+}
+
+// ARM920T
+
+int audio940Connect(unsigned long timeoutNs) {
+  uint32_t start = timerGet();
+  while(arm920Data[REG_READY] != SERVICE_READY) {
+    if(arm920Data[REG_READY] == SERVICE_FAILED || timerNsSince(start, NULL) > timeoutNs) {
+      return 1;
+    }
+  }
+
+  ringAttach(&commandRing, importPointer(arm920Data[REG_QUEUE_LOW] | (arm920Data[REG_QUEUE_HIGH] << 16)));
+  return 0;
+}
+
+static void audio940_post(CommandType type, int voice, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+  Audio940Command command = {
+			     .type = type,
+			     .voice = voice,
+			     .args = { arg0, arg1, arg2 }
+  };
+  while(!ringPush(&commandRing, &command)); // ring full, the ARM940T is behind
+  arm940Data[REG_DOORBELL]++;
+}
+
+void audio940Play(int voice, const void* data, int length, MixerFormat format, bool loop) {
+  audio940_post(COMMAND_PLAY, voice, (uint32_t)data, length, format | (loop ? BIT(8) : 0)); // the ARM940T imports it
+}
+
+void audio940Stop(int voice) {
+  audio940_post(COMMAND_STOP, voice, 0, 0, 0);
+}
+
+void audio940SetVolume(int voice, int volume, int pan) {
+  audio940_post(COMMAND_VOLUME, voice, volume, pan, 0);
+}
+
+void audio940SetRate(int voice, int sampleRate) {
+  audio940_post(COMMAND_RATE, voice, sampleRate, 0, 0);
+}
+
+void audio940SetOutputRate(int sampleRate) {
+  audio940_post(COMMAND_OUTPUT_RATE, 0, sampleRate, 0, 0);
+}
+
+bool audio940IsPlaying(int voice) {
+  return arm920Data[REG_PLAYING] & BIT(voice) ? true : false;
+}
@@ -123,6 +123,182 @@ void cacheInvalidateDI() {
   }
 }
 
+/*
+  Range operations. The ARM920T can clean and invalidate single lines by address, but the ARM940T can only work
+  through its cache by index, so on the ARM940T (and on the ARM920T once a range is as big as the cache) the whole
+  cache is done by index instead. Invalidating the whole cache would throw away other dirty data, so ranges are
+  only ever invalidated that way along with a clean. Ways locked by cacheLockD() are only cleaned, so locked data
+  survives large range operations such as the SD card's DMA transfers.
+*/
+#define CACHE_LINE_920 32
+#define CACHE_SIZE_920 0x4000
+
+static uint32_t lockedWaysD = 0;
+static uint32_t lockedWaysI = 0;
+
+typedef enum {
+	      CACHE_CLEAN,
+	      CACHE_CLEAN_INVALIDATE
+} CacheOp;
+
+static void cache_wholeByIndex(CacheOp op) {
+  if(!arm940IsThis()) {
+    // 8 segments of 64 lines, index in bits 26-31 and segment in bits 5-7
+    for(uint32_t segment = 0 ; segment < 8 ; segment++) {
+      for(uint32_t index = 0 ; index < 64 ; index++) {
+	uint32_t r = (index << 26) | (segment << 5);
+	if(op == CACHE_CLEAN || index < lockedWaysD) {
+	  asm volatile("mcr p15, 0, %[r], c7, c10, 2" : : [r] "r" (r) : "memory");
+	} else {
+	  asm volatile("mcr p15, 0, %[r], c7, c14, 2" : : [r] "r" (r) : "memory");
+	}
+      }
+    }
+  } else {
+    // 4 segments of 64 lines, index in bits 26-31 and segment in bits 4-5
+    for(uint32_t segment = 0 ; segment < 4 ; segment++) {
+      for(uint32_t index = 0 ; index < 64 ; index++) {
+	uint32_t r = (index << 26) | (segment << 4);
+	if(op == CACHE_CLEAN) {
+	  asm volatile("mcr p15, 0, %[r], c7, c10, 2" : : [r] "r" (r) : "memory");
+	} else {
+	  asm volatile("mcr p15, 0, %[r], c7, c14, 2" : : [r] "r" (r) : "memory");
+	}
+      }
+    }
+  }
+}
+
+static inline bool cache_useWhole(uint32_t bytes) {
+  return arm940IsThis() || bytes >= CACHE_SIZE_920;
+}
+
+void cacheDrainWriteBuffer() {
+  asm volatile("mov r0, #0;  \
+                mcr p15, 0, r0, c7, c10, 4"
+	       : // no outputs
+	       : // no inputs
+	       :"r0", "memory"
+	       );
+}
+
+void cacheCleanRange(const void* start, uint32_t bytes) {
+  if(cache_useWhole(bytes)) {
+    cache_wholeByIndex(CACHE_CLEAN);
+  } else {
+    uint32_t end = ((uint32_t)start) + bytes;
+    for(uint32_t line = ((uint32_t)start) & ~(CACHE_LINE_920-1) ; line < end ; line += CACHE_LINE_920) {
+      asm volatile("mcr p15, 0, %[line], c7, c10, 1" : : [line] "r" (line) : "memory");
+    }
+  }
+  cacheDrainWriteBuffer();
+}
+
+void cacheInvalidateRange(void* start, uint32_t bytes) {
+  if(cache_useWhole(bytes)) {
+    cache_wholeByIndex(CACHE_CLEAN_INVALIDATE);
+    cacheDrainWriteBuffer();
+    return;
+  }
+
+  uint32_t first = ((uint32_t)start) & ~(CACHE_LINE_920-1);
+  uint32_t end = ((uint32_t)start) + bytes;
+  for(uint32_t line = first ; line < end ; line += CACHE_LINE_920) {
+    // lines only partly in the range may hold someone else's dirty data, so write those back as well
+    if(line < (uint32_t)start || line + CACHE_LINE_920 > end) {
+      asm volatile("mcr p15, 0, %[line], c7, c14, 1" : : [line] "r" (line) : "memory");
+    } else {
+      asm volatile("mcr p15, 0, %[line], c7, c6, 1" : : [line] "r" (line) : "memory");
+    }
+  }
+  cacheDrainWriteBuffer();
+}
+
+void cacheCleanInvalidateRange(void* start, uint32_t bytes) {
+  if(cache_useWhole(bytes)) {
+    cache_wholeByIndex(CACHE_CLEAN_INVALIDATE);
+  } else {
+    uint32_t end = ((uint32_t)start) + bytes;
+    for(uint32_t line = ((uint32_t)start) & ~(CACHE_LINE_920-1) ; line < end ; line += CACHE_LINE_920) {
+      asm volatile("mcr p15, 0, %[line], c7, c14, 1" : : [line] "r" (line) : "memory");
+    }
+  }
+  cacheDrainWriteBuffer();
+}
+
+/*
+  Lockdown on the ARM920T. Both caches are 8 segments of 64 lines, and the lockdown base stops the victim counter
+  in every segment from replacing lines below it. A 256 byte block of memory covers one line in each segment, so
+  filling the cache with a block while the base and victim are both at n puts it in line n of every segment, and
+  moving the base past it locks it in.
+*/
+#define CACHE_SEGMENTS_920 8
+#define CACHE_MAX_LOCKED_WAYS 63
+
+static inline void cache_setLockdownD(uint32_t base) {
+  asm volatile("mcr p15, 0, %[r], c9, c0, 0" : : [r] "r" (base << 26) : "memory");
+}
+
+static inline void cache_setLockdownI(uint32_t base) {
+  asm volatile("mcr p15, 0, %[r], c9, c0, 1" : : [r] "r" (base << 26) : "memory");
+}
+
+// blocks of CACHE_WAY_BYTES covering the range, each of which takes a way
+static bool cache_lockSpan(const void* start, uint32_t bytes, uint32_t lockedWays, uint32_t* first, uint32_t* end) {
+  *first = ((uint32_t)start) & ~(CACHE_WAY_BYTES-1);
+  *end = (((uint32_t)start) + bytes + (CACHE_WAY_BYTES-1)) & ~(CACHE_WAY_BYTES-1);
+  return !arm940IsThis() && bytes > 0 && lockedWays + ((*end - *first) / CACHE_WAY_BYTES) <= CACHE_MAX_LOCKED_WAYS;
+}
+
+int cacheLockD(const void* start, uint32_t bytes) {
+  uint32_t first, end;
+  if(!cache_lockSpan(start, bytes, lockedWaysD, &first, &end)) {
+    return 1;
+  }
+
+  // nothing else may fill the cache while the victim counter is pointing at the ways being locked
+  uint32_t state = irqSuspendAll();
+  cacheCleanInvalidateRange((void*)first, end - first); // lines already in the cache wouldn't be loaded again
+  cache_setLockdownD(lockedWaysD);
+  for(uint32_t line = first ; line < end ; line += CACHE_LINE_920) {
+    asm volatile("ldr r0, [%[line]]" : : [line] "r" (line) : "r0", "memory");
+  }
+  lockedWaysD += (end - first) / CACHE_WAY_BYTES;
+  cache_setLockdownD(lockedWaysD);
+  irqResume(state);
+  return 0;
+}
+
+void cacheUnlockD() {
+  lockedWaysD = 0;
+  cache_setLockdownD(0);
+}
+
+int cacheLockI(const void* start, uint32_t bytes) {
+  uint32_t first, end;
+  if(!cache_lockSpan(start, bytes, lockedWaysI, &first, &end)) {
+    return 1;
+  }
+
+  uint32_t state = irqSuspendAll();
+  for(uint32_t line = first ; line < end ; line += CACHE_LINE_920) {
+    asm volatile("mcr p15, 0, %[line], c7, c5, 1" : : [line] "r" (line) : "memory");
+  }
+  cache_setLockdownI(lockedWaysI);
+  for(uint32_t line = first ; line < end ; line += CACHE_LINE_920) {
+    asm volatile("mcr p15, 0, %[line], c7, c13, 1" : : [line] "r" (line) : "memory"); // prefetch
+  }
+  lockedWaysI += (end - first) / CACHE_WAY_BYTES;
+  cache_setLockdownI(lockedWaysI);
+  irqResume(state);
+  return 0;
+}
+
+void cacheUnlockI() {
+  lockedWaysI = 0;
+  cache_setLockdownI(0);
+}
+
 void mmuEnable(void* l1Table) {
   asm volatile("mcr p15, 0, %0, c2, c0, 0;  \
                 mov r0, #0;  \
@@ -147,20 +323,218 @@ void mmuDisable() {
 	       );
 }
 
-uint32_t* mmuNewL1Table() {
+static inline bool mmu_cacheable(MemoryAttributes attributes) {
+  return attributes == MEM_WRITE_THROUGH || attributes == MEM_WRITE_BACK;
+}
+
+static inline bool mmu_buffered(MemoryAttributes attributes) {
+  return attributes == MEM_BUFFERED || attributes == MEM_WRITE_BACK;
+}
+
+static inline uint32_t mmu_section(uint32_t index, MemoryAttributes attributes) {
+  return SECTION_DESCRIPTOR(index*SZ_1M, AP(READ_WRITE, true), 0, mmu_cacheable(attributes), mmu_buffered(attributes));
+}
+
+void mmuSetRegions(uint32_t* l1Table, const MemoryRegion* regions, int count) {
+  for(int r = 0 ; r < count ; r++) {
+    // whole sections covering the region
+    uint64_t end = (((uint64_t)regions[r].address) + regions[r].size + (SZ_1M-1)) / SZ_1M;
+    for(uint32_t i = regions[r].address / SZ_1M ; i < end && i < 4096 ; i++) {
+      l1Table[i] = mmu_section(i, regions[r].attributes);
+    }
+  }
+}
+
+uint32_t* mmuNewL1TableFromRegions(const MemoryRegion* regions, int count) {
   uint32_t* l1Table = (uint32_t*) memalign(MMU_L1_ALIGN, 0x4000);
   // allocate a table of 4096 x 32-bit entries aligned to a 16K boundary
   if(l1Table != NULL) {
     for(int i = 4096 ; i-- ; ) {
-      l1Table[i] = i < 64 ? SECTION_DESCRIPTOR(i*SZ_1M, AP(READ_WRITE, true), 0, true, true)
-      	: SECTION_DESCRIPTOR(i*SZ_1M, AP(READ_WRITE, true), 0, false, false);
+      l1Table[i] = mmu_section(i, MEM_UNCACHED);
     }
+    mmuSetRegions(l1Table, regions, count);
     return l1Table;
   } else {
     return NULL;
   }
 }
 
+uint32_t* mmuNewL1Table() {
+  MemoryRegion ram = { .address = 0x0, .size = 64*SZ_1M, .attributes = MEM_WRITE_BACK };
+  return mmuNewL1TableFromRegions(&ram, 1);
+}
+
+static uint32_t* mmu_newL2Table(uint32_t align, int entries) {
+  uint32_t* table = (uint32_t*) memalign(align, entries*4);
+  if(table != NULL) {
+    for(int i = entries ; i-- ; ) {
+      table[i] = 0x0; // fault
+    }
+  }
+  return table;
+}
+
+uint32_t* mmuNewCoarseTable() {
+  return mmu_newL2Table(MMU_COARSE_ALIGN, 256);
+}
+
+uint32_t* mmuNewFineTable() {
+  return mmu_newL2Table(MMU_FINE_ALIGN, 1024);
+}
+
+static void mmu_invalidateTLB() {
+  asm volatile("mov r0, #0;  \
+                mcr p15, 0, r0, c8, c7, 0"
+	       : // no outputs
+	       : // no inputs
+	       :"r0", "memory"
+	       );
+}
+
+/*
+  Find the L2 table covering a virtual address, splitting a section into one if needed. Coarse tables are used
+  unless 1K tiny pages are wanted, which only fine tables can hold, and a coarse table is copied into a fine one the
+  first time a tiny page goes into it. New tables keep the mapping they replace, so only the pages being changed
+  behave any differently. L2 tables are allocated from RAM, which is mapped flat, so their address is also their
+  physical address.
+
+  In a fine table every entry covers 1K, so small pages are repeated 4 times and large pages 64 times.
+*/
+static uint32_t* mmu_l2For(uint32_t* l1Table, uint32_t virtualAddr, bool needFine, bool* isFine) {
+  uint32_t* entry = &l1Table[virtualAddr / SZ_1M];
+  uint32_t descriptor = *entry;
+  uint32_t* table;
+  uint32_t* replaced = NULL;
+
+  switch(descriptor & 0x3) {
+  case 0x3:
+    *isFine = true;
+    return (uint32_t*) (descriptor & 0xFFFFF000);
+  case 0x1:
+    if(!needFine) {
+      *isFine = false;
+      return (uint32_t*) (descriptor & 0xFFFFFC00);
+    }
+    table = mmuNewFineTable();
+    if(table != NULL) {
+      replaced = (uint32_t*) (descriptor & 0xFFFFFC00);
+      for(int i = 0 ; i < 1024 ; i++) {
+	table[i] = replaced[i / 4];
+      }
+    }
+    break;
+  case 0x2:
+    table = needFine ? mmuNewFineTable() : mmuNewCoarseTable();
+    if(table != NULL) {
+      uint32_t ap = (descriptor >> 10) & 0x3;
+      bool cacheable = descriptor & BIT(3);
+      bool buffered = descriptor & BIT(2);
+      int entries = needFine ? 1024 : 256;
+      for(int i = 0 ; i < entries ; i++) {
+	table[i] = LARGE_DESCRIPTOR((descriptor & 0xFFF00000) + ((i / (entries / 16)) * SZ_64K), ap, ap, ap, ap, cacheable, buffered);
+      }
+    }
+    break;
+  default:
+    table = needFine ? mmuNewFineTable() : mmuNewCoarseTable();
+    break;
+  }
+
+  if(table != NULL) {
+    uint32_t domain = (descriptor >> 5) & 0xF;
+    cacheCleanRange(table, (needFine ? 1024 : 256)*4);
+    *entry = needFine ? FINE_DESCRIPTOR((uint32_t)table, domain) : COARSE_DESCRIPTOR((uint32_t)table, domain);
+    cacheCleanRange(entry, 4);
+    // nothing reads a coarse table once the L1 entry points at the fine table copied from it
+    free(replaced);
+  }
+  *isFine = needFine;
+  return table;
+}
+
+// all entries of a large page have to match, so turn it into small pages before changing part of it
+static void mmu_splitLargePage(uint32_t* table, bool isFine, uint32_t first) {
+  uint32_t descriptor = table[first];
+  int entries = isFine ? 64 : 16;
+  if((descriptor & 0x3) == 0x1) {
+    for(int i = 0 ; i < entries ; i++) {
+      table[first + i] = ((descriptor & 0xFFFF0000) + ((isFine ? i / 4 : i) * SZ_4K)) | (descriptor & 0xFFC) | 0x2;
+    }
+    cacheCleanRange(&table[first], entries*4);
+  }
+}
+
+// likewise the 4 entries of a small page in a fine table, before changing one of them to a tiny page
+static void mmu_splitSmallPage(uint32_t* fine, uint32_t first) {
+  uint32_t descriptor = fine[first];
+  if((descriptor & 0x3) == 0x2) {
+    for(uint32_t i = 0 ; i < 4 ; i++) {
+      fine[first + i] = TINY_DESCRIPTOR((descriptor & 0xFFFFF000) + (i * SZ_1K), (descriptor >> 4) & 0x3,
+					descriptor & BIT(3), descriptor & BIT(2));
+    }
+    cacheCleanRange(&fine[first], 4*4);
+  }
+}
+
+static int mmu_setPages(uint32_t* l1Table, uint32_t virtualAddr, uint32_t physicalAddr, uint32_t size, bool map, MemoryAttributes attributes) {
+  if((virtualAddr | physicalAddr | size) & (SZ_1K-1)) {
+    return 1;
+  }
+
+  uint32_t ap = AP(READ_WRITE, true);
+  bool cacheable = mmu_cacheable(attributes);
+  bool buffered = mmu_buffered(attributes);
+  int result = 0;
+
+  while(size > 0) {
+    // the biggest page the range allows from here
+    uint32_t alignment = virtualAddr | physicalAddr;
+    uint32_t pageSize = (!(alignment & (SZ_64K-1)) && size >= SZ_64K) ? SZ_64K
+      : (!(alignment & (SZ_4K-1)) && size >= SZ_4K) ? SZ_4K
+      : SZ_1K;
+
+    bool isFine;
+    uint32_t* table = mmu_l2For(l1Table, virtualAddr, pageSize == SZ_1K, &isFine);
+    if(table == NULL) {
+      result = 2;
+      break;
+    }
+
+    uint32_t descriptor = !map ? 0x0
+      : pageSize == SZ_64K ? LARGE_DESCRIPTOR(physicalAddr, ap, ap, ap, ap, cacheable, buffered)
+      : pageSize == SZ_4K ? SMALL_DESCRIPTOR(physicalAddr, ap, ap, ap, ap, cacheable, buffered)
+      : TINY_DESCRIPTOR(physicalAddr, ap, cacheable, buffered);
+    uint32_t entrySize = isFine ? SZ_1K : SZ_4K;
+    uint32_t index = (virtualAddr & (SZ_1M-1)) / entrySize;
+    if(pageSize != SZ_64K) {
+      mmu_splitLargePage(table, isFine, index & ~(SZ_64K/entrySize - 1));
+    }
+    if(pageSize == SZ_1K) {
+      mmu_splitSmallPage(table, index & ~0x3);
+    }
+    uint32_t* pageEntry = &table[index];
+    for(uint32_t i = 0 ; i < pageSize / entrySize ; i++) {
+      pageEntry[i] = descriptor;
+    }
+    cacheCleanRange(pageEntry, (pageSize / entrySize) * 4);
+
+    virtualAddr += pageSize;
+    physicalAddr += pageSize;
+    size -= pageSize;
+  }
+
+  mmu_invalidateTLB();
+  return result;
+}
+
+int mmuMapPages(uint32_t* l1Table, uint32_t virtualAddr, uint32_t physicalAddr, uint32_t size, MemoryAttributes attributes) {
+  return mmu_setPages(l1Table, virtualAddr, physicalAddr, size, true, attributes);
+}
+
+int mmuUnmapPages(uint32_t* l1Table, uint32_t virtualAddr, uint32_t size) {
+  return mmu_setPages(l1Table, virtualAddr, 0, size, false, MEM_UNCACHED);
+}
+
 uint32_t mmuSetDomainAccess(unsigned int domain, DomainAccess access) {
   uint32_t domainAccess = 0;
   uint32_t mask = (0x3 << (2*domain));
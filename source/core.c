@@ -56,7 +56,7 @@ static void arm920_gp2xInit() {
   // set up NAND timings
   REG16(MEMNANDTIMEW) = 0x7F8;
   
-  // TODO understand the interrupt subsystem, seems pretty simple, jut specify fiq/irq for each type, and there is a register which the ISR can read to see what caused it - chapter 8 'interrupt controller'
+  // interrupts are left alone until irqInit() is called, drivers fall back to polling without them
 
   extern void* heap_ptr;
   heap_ptr = (void*)&__start_of_heap;
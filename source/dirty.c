@@ -0,0 +1,160 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stddef.h>
+
+/*
+  Rectangles in a region are kept from overlapping, so nothing gets drawn twice. A new rectangle swallows any it
+  covers and is dropped if it is already covered, and rectangles are merged when their bounding box costs no more to
+  draw than the two of them apart. Once the region is full the cheapest merge is taken whatever it costs.
+*/
+static inline int dirty_min(int a, int b) {
+  return a < b ? a : b;
+}
+
+static inline int dirty_max(int a, int b) {
+  return a > b ? a : b;
+}
+
+static inline int dirty_area(const Rect* r) {
+  return r->w * r->h;
+}
+
+static Rect dirty_union(const Rect* a, const Rect* b) {
+  int x = dirty_min(a->x, b->x);
+  int y = dirty_min(a->y, b->y);
+  return (Rect){x, y, dirty_max(a->x + a->w, b->x + b->w) - x, dirty_max(a->y + a->h, b->y + b->h) - y};
+}
+
+static int dirty_overlap(const Rect* a, const Rect* b) {
+  int w = dirty_min(a->x + a->w, b->x + b->w) - dirty_max(a->x, b->x);
+  int h = dirty_min(a->y + a->h, b->y + b->h) - dirty_max(a->y, b->y);
+  return (w > 0 && h > 0) ? w*h : 0;
+}
+
+static bool dirty_contains(const Rect* outer, const Rect* inner) {
+  return inner->x >= outer->x && inner->y >= outer->y
+    && inner->x + inner->w <= outer->x + outer->w && inner->y + inner->h <= outer->y + outer->h;
+}
+
+static inline void dirty_remove(DirtyRegion* region, int idx) {
+  region->rects[idx] = region->rects[--region->count];
+}
+
+// extra area drawn by merging two rectangles rather than drawing them apart
+static int dirty_mergeCost(const Rect* a, const Rect* b) {
+  Rect u = dirty_union(a, b);
+  return dirty_area(&u) - (dirty_area(a) + dirty_area(b) - dirty_overlap(a, b));
+}
+
+void dirtyClear(DirtyRegion* region) {
+  region->count = 0;
+}
+
+void dirtyAdd(DirtyRegion* region, const Rect* rect) {
+  if(rect->w <= 0 || rect->h <= 0) {
+    return;
+  }
+
+  Rect r = *rect;
+  bool merged = true;
+  while(merged) {
+    merged = false;
+    for(int i = 0 ; i < region->count ; i++) {
+      if(dirty_contains(&region->rects[i], &r)) {
+	return;
+      }
+      // merging anything which overlaps keeps the rectangles apart from each other
+      if(dirty_contains(&r, &region->rects[i]) || dirty_overlap(&r, &region->rects[i]) > 0
+	 || dirty_mergeCost(&r, &region->rects[i]) <= 0) {
+	r = dirty_union(&r, &region->rects[i]);
+	dirty_remove(region, i);
+	merged = true;
+	break;
+      }
+    }
+  }
+
+  while(region->count >= DIRTY_MAX_RECTS) {
+    int best = 0;
+    for(int i = 1 ; i < region->count ; i++) {
+      if(dirty_mergeCost(&r, &region->rects[i]) < dirty_mergeCost(&r, &region->rects[best])) {
+	best = i;
+      }
+    }
+    r = dirty_union(&r, &region->rects[best]);
+    dirty_remove(region, best);
+
+    // the bigger rectangle may now overlap others
+    for(int i = 0 ; i < region->count ; ) {
+      if(dirty_overlap(&r, &region->rects[i]) > 0) {
+	r = dirty_union(&r, &region->rects[i]);
+	dirty_remove(region, i);
+	i = 0;
+      } else {
+	i++;
+      }
+    }
+  }
+  region->rects[region->count++] = r;
+}
+
+int dirtyTrackerInit(DirtyTracker* tracker, void** buffers, int count, int w, int h) {
+  if(count < 1 || count > DIRTY_MAX_BUFFERS) {
+    return 1;
+  }
+
+  tracker->count = count;
+  tracker->bounds = (Rect){0, 0, w, h};
+  for(int i = 0 ; i < count ; i++) {
+    tracker->buffers[i] = buffers[i];
+    dirtyClear(&tracker->regions[i]);
+    dirtyClear(&tracker->drawing[i]);
+    dirtyAdd(&tracker->regions[i], &tracker->bounds);
+  }
+  return 0;
+}
+
+void dirtyTrackerAdd(DirtyTracker* tracker, const Rect* rect) {
+  int x = dirty_max(rect->x, tracker->bounds.x);
+  int y = dirty_max(rect->y, tracker->bounds.y);
+  Rect clipped = {
+		  x,
+		  y,
+		  dirty_min(rect->x + rect->w, tracker->bounds.x + tracker->bounds.w) - x,
+		  dirty_min(rect->y + rect->h, tracker->bounds.y + tracker->bounds.h) - y
+  };
+
+  for(int i = 0 ; i < tracker->count ; i++) {
+    dirtyAdd(&tracker->regions[i], &clipped);
+  }
+}
+
+static int dirty_bufferIndex(DirtyTracker* tracker, void* buffer) {
+  for(int i = 0 ; i < tracker->count ; i++) {
+    if(tracker->buffers[i] == buffer) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// the region moves out to be drawn, so anything added while drawing is left for next time
+DirtyRegion* dirtyTrackerGet(DirtyTracker* tracker, void* buffer) {
+  int i = dirty_bufferIndex(tracker, buffer);
+  if(i < 0) {
+    return NULL;
+  }
+
+  for(int r = 0 ; r < tracker->regions[i].count ; r++) {
+    dirtyAdd(&tracker->drawing[i], &tracker->regions[i].rects[r]);
+  }
+  dirtyClear(&tracker->regions[i]);
+  return &tracker->drawing[i];
+}
+
+void dirtyTrackerDone(DirtyTracker* tracker, void* buffer) {
+  int i = dirty_bufferIndex(tracker, buffer);
+  if(i >= 0) {
+    dirtyClear(&tracker->drawing[i]);
+  }
+}
@@ -1,5 +1,6 @@
 #include <gp2xregs.h>
 #include <orcus.h>
+#include <string.h>
 
 extern void orcus_delay(int loops);
 
@@ -125,6 +126,152 @@ void rgbSetFbAddress(void* fb) {
   REG16(MLC_STL_EADRH) = addr >> 16;
 }
 
+/*
+  Page flipping
+
+  Buffers are tracked by index - one on screen, up to two queued for display and one being drawn. Flips are queued
+  in order and the vsync interrupt latches the oldest, so with three buffers the renderer can get a frame ahead
+  without waiting for the display.
+*/
+#define MAX_FLIP_BUFFERS 3
+
+static void* flipBuffers[MAX_FLIP_BUFFERS];
+static int flipBufferCount = 0;
+static volatile int backBuffer = -1;
+static volatile int frontBuffer;
+static volatile int flipQueue[MAX_FLIP_BUFFERS];
+static volatile int flipQueueHead;
+static volatile int flipQueueLength;
+static uint32_t flipTicks[MAX_FLIP_BUFFERS];
+static uint32_t lastLatchTick;
+static volatile uint32_t vsyncCount = 0;
+static RgbFlipStats flipStats;
+static uint64_t totalLatencyNs;
+
+static void orcus_vsyncHandler() {
+  REG16(DPC_INTR) = DPC_INTR_VSINTEN | DPC_INTR_VSINT; // write 1 to clear, only ack vsync
+  vsyncCount++;
+  flipStats.vsyncs++;
+
+  if(flipQueueLength == 0) {
+    if(backBuffer >= 0) {
+      flipStats.missedVSyncs++; // still drawing, the current frame gets shown again
+    }
+    return;
+  }
+
+  int idx = flipQueue[flipQueueHead];
+  flipQueueHead = (flipQueueHead + 1) % MAX_FLIP_BUFFERS;
+  flipQueueLength--;
+  rgbSetFbAddress(flipBuffers[idx]);
+  frontBuffer = idx;
+
+  uint32_t latency = timerNsSince(flipTicks[idx], NULL);
+  flipStats.frames++;
+  flipStats.lastLatencyNs = latency;
+  if(latency > flipStats.maxLatencyNs) {
+    flipStats.maxLatencyNs = latency;
+  }
+  totalLatencyNs += latency;
+  flipStats.lastFrameNs = timerNsSince(lastLatchTick, &lastLatchTick);
+}
+
+static bool orcus_flipBufferInUse(int idx) {
+  if(idx == frontBuffer || idx == backBuffer) {
+    return true;
+  }
+  for(int i = 0 ; i < flipQueueLength ; i++) {
+    if(flipQueue[(flipQueueHead + i) % MAX_FLIP_BUFFERS] == idx) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int rgbFlipInit(void** buffers, int count) {
+  if(count < 2 || count > MAX_FLIP_BUFFERS) {
+    return 1;
+  }
+
+  irqDisable(IRQ_DISP);
+  for(int i = 0 ; i < count ; i++) {
+    flipBuffers[i] = buffers[i];
+  }
+  flipBufferCount = count;
+  frontBuffer = 0;
+  backBuffer = -1;
+  flipQueueHead = 0;
+  flipQueueLength = 0;
+  rgbSetFbAddress(flipBuffers[0]);
+
+  rgbFlipResetStats();
+  lastLatchTick = timerGet();
+
+  irqSetHandler(IRQ_DISP, orcus_vsyncHandler);
+  REG16(DPC_INTR) = DPC_INTR_VSINTEN | DPC_INTR_VSINT;
+  irqEnable(IRQ_DISP);
+  return 0;
+}
+
+void rgbFlipStop() {
+  irqDisable(IRQ_DISP);
+  REG16(DPC_INTR) = DPC_INTR_VSINT;
+  if(flipQueueLength > 0) {
+    // show the most recent frame rather than dropping it
+    rgbSetFbAddress(flipBuffers[flipQueue[(flipQueueHead + flipQueueLength - 1) % MAX_FLIP_BUFFERS]]);
+  }
+  flipQueueLength = 0;
+  flipBufferCount = 0;
+}
+
+void* rgbFlipGetBackBuffer() {
+  if(flipBufferCount == 0) {
+    return NULL;
+  }
+
+  while(backBuffer < 0) {
+    uint32_t state = irqSuspend();
+    for(int i = 0 ; i < flipBufferCount ; i++) {
+      if(!orcus_flipBufferInUse(i)) {
+	backBuffer = i;
+	break;
+      }
+    }
+    if(backBuffer < 0) {
+      irqWaitForInterrupt(); // every buffer is on screen or queued, wait for a vsync to free one
+    }
+    irqResume(state);
+  }
+  return flipBuffers[backBuffer];
+}
+
+void rgbFlip() {
+  if(backBuffer < 0) {
+    return;
+  }
+
+  uint32_t state = irqSuspend();
+  flipTicks[backBuffer] = timerGet();
+  flipQueue[(flipQueueHead + flipQueueLength) % MAX_FLIP_BUFFERS] = backBuffer;
+  flipQueueLength++;
+  backBuffer = -1;
+  irqResume(state);
+}
+
+void rgbFlipGetStats(RgbFlipStats* stats) {
+  uint32_t state = irqSuspend();
+  *stats = flipStats;
+  stats->averageLatencyNs = flipStats.frames ? totalLatencyNs / flipStats.frames : 0;
+  irqResume(state);
+}
+
+void rgbFlipResetStats() {
+  uint32_t state = irqSuspend();
+  memset(&flipStats, 0, sizeof(flipStats));
+  totalLatencyNs = 0;
+  irqResume(state);
+}
+
 // region 5 cannot be moved
 void rgbSetRegionPosition(RgbRegion region, int x, int y, int width, int height) {
   if(region < 5) {
@@ -149,6 +296,19 @@ bool lcdVSync() {
 }
 
 void lcdWaitNextVSync() {
+  if(flipBufferCount > 0) {
+    // the vsync interrupt is running, sleep until it next fires
+    uint32_t count = vsyncCount;
+    while(vsyncCount == count) {
+      uint32_t state = irqSuspend();
+      if(vsyncCount == count) {
+	irqWaitForInterrupt();
+      }
+      irqResume(state);
+    }
+    return;
+  }
+
   while(lcdVSync());
   while(!lcdVSync());
 }
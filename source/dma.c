@@ -1,5 +1,10 @@
 #include <gp2xregs.h>
 #include <orcus.h>
+#include <stddef.h>
+
+#define DMA_CHANNELS 16
+
+static DmaHandler finishedHandlers[DMA_CHANNELS];
 
 void dmaConfigureChannelMem(int channel, BurstMode burstMode, int8_t srcIncrement, int8_t destIncrement) {
   REG16(DCH0SRM + (channel * 4)) &= 0xFF80; // this is not an IO device
@@ -23,16 +28,28 @@ void dmaConfigureChannelIO(int channel, BurstMode burstMode, int8_t srcIncrement
 
 }
 
+void dmaConfigureChannelFromIO(int channel, BurstMode burstMode, int8_t srcIncrement, int8_t destIncrement, Peripheral peripheral) {
+  REG16(DCH0TRM + (channel * 4)) &= 0xFF80; // target is memory
+  REG16(DCH0SRM + (channel * 4)) = BIT(6) | peripheral;
+  REG16(DMAREG(DMACOM0, channel)) = (burstMode << 14)
+    | ((srcIncrement == 0 ? 0x0 : 0x1) << 13)
+    | BIT(12)
+    | (0x2 << 8) // 32-bit peripheral
+    | ((destIncrement == 0 ? 0x0 : 0x1) << 5);
+  REG16(DMAREG(DMACOM1, channel)) = (srcIncrement << 8) | destIncrement;
+  REG16(DMAREG(DMACONS, channel)) = 0x0;
+}
+
 void dmaStart(int channel, uint16_t length, uint32_t src, uint32_t dest) {
-  REG16(DMAREG(DMACONS, channel)) &= ~(BIT(1) | BIT(2));
+  REG16(DMAREG(DMACONS, channel)) &= ~(DMACONS_END | BIT(2));
   REG32(DMAREG(DMASRCADDR, channel)) = src;
   REG32(DMAREG(DMATRGADDR, channel)) = dest;
   REG16(DMAREG(DMACOM2, channel)) = length;
-  REG16(DMAREG(DMACONS, channel)) |= BIT(10);
+  REG16(DMAREG(DMACONS, channel)) |= DMACONS_RUN;
 }
 
 void dmaStop(int channel) {
-  REG16(DMAREG(DMACONS, channel)) &= ~BIT(10);
+  REG16(DMAREG(DMACONS, channel)) &= ~DMACONS_RUN;
 }
 
 bool dmaIsTransferring(int channel) {
@@ -40,5 +57,39 @@ bool dmaIsTransferring(int channel) {
 }
 
 bool dmaHasFinished(int channel) {
-  return REG16(DMAREG(DMACONS, channel)) & BIT(1);  
+  return REG16(DMAREG(DMACONS, channel)) & DMACONS_END;
+}
+
+static void orcus_dmaIrqHandler() {
+  uint16_t pending = REG16(DMAINT);
+  REG16(DMAINT) = pending;
+  for(int channel = 0 ; pending ; channel++, pending >>= 1) {
+    if((pending & 0x1) && finishedHandlers[channel] != NULL) {
+      finishedHandlers[channel](channel);
+    }
+  }
+}
+
+void dmaSetFinishedHandler(int channel, DmaHandler handler) {
+  // the handler can restart its channel, so keep it out while the channel's control register is changed
+  uint32_t state = irqSuspend();
+  finishedHandlers[channel] = handler;
+  if(handler != NULL) {
+    REG16(DMAREG(DMACONS, channel)) |= DMACONS_IRQ_EN;
+  } else {
+    REG16(DMAREG(DMACONS, channel)) &= ~DMACONS_IRQ_EN;
+  }
+
+  bool anyHandlers = false;
+  for(int i = 0 ; i < DMA_CHANNELS ; i++) {
+    anyHandlers = anyHandlers || finishedHandlers[i] != NULL;
+  }
+  if(anyHandlers) {
+    irqSetHandler(IRQ_DMA, orcus_dmaIrqHandler);
+    irqEnable(IRQ_DMA);
+  } else {
+    // the last handler has gone, so nothing is left to take the interrupt
+    irqDisable(IRQ_DMA);
+  }
+  irqResume(state);
 }
@@ -0,0 +1,167 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stddef.h>
+
+#define IRQ_STACK_WORDS 1024
+#define FIQ_STACK_WORDS 256
+#define MODE_MASK 0x1F
+#define MODE_FIQ 0x11
+#define MODE_IRQ 0x12
+#define CPSR_F BIT(6)
+#define CPSR_I BIT(7)
+
+/*
+  One table for both kinds of interrupt. IRQs are looked up directly from INTOFFSET, FIQs don't get an offset so
+  the FIQ dispatcher works through the pending FIQ sources instead.
+*/
+static IrqHandler handlers[32];
+static uint32_t irqStack[IRQ_STACK_WORDS] __attribute__((aligned(8)));
+static uint32_t fiqStack[FIQ_STACK_WORDS] __attribute__((aligned(8)));
+
+static void __attribute__((interrupt("IRQ"))) orcus_irqHandler() {
+  uint32_t source = REG32(INTOFFSET) & 0x1F;
+  if(handlers[source] != NULL) {
+    handlers[source]();
+  }
+
+  // acknowledge once the handler has cleared the cause, otherwise the source is still asserted
+  REG32(SRCPEND) = 1u << source;
+  REG32(INTPEND) = 1u << source;
+}
+
+static void __attribute__((interrupt("FIQ"))) orcus_fiqHandler() {
+  uint32_t pending = REG32(SRCPEND) & REG32(INTMOD) & ~REG32(INTMASK);
+  for(uint32_t source = 0 ; pending ; source++, pending >>= 1) {
+    if(pending & 0x1) {
+      if(handlers[source] != NULL) {
+	handlers[source]();
+      }
+      REG32(SRCPEND) = 1u << source;
+    }
+  }
+}
+
+// the interrupt controller belongs to the ARM920T, the only interrupt the ARM940T gets is from the data registers
+static void __attribute__((interrupt("IRQ"))) orcus_irq940Handler() {
+  if(handlers[IRQ_DUALCPU] != NULL) {
+    handlers[IRQ_DUALCPU]();
+  }
+}
+
+// stackTop is pinned to r2, as r8 - r12 are banked in FIQ mode and would read as the FIQ copies once switched
+static void orcus_setModeStack(uint32_t mode, uint32_t* stackTop) {
+  register uint32_t* top asm("r2") = stackTop;
+  asm volatile("mrs r0, cpsr\n"
+	       "bic r1, r0, %1\n"
+	       "orr r1, r1, %2\n"
+	       "msr cpsr_c, r1\n"
+	       "mov sp, %0\n"
+	       "msr cpsr_c, r0"
+	       : : "r"(top), "I"(MODE_MASK), "r"(mode) : "r0", "r1", "memory");
+}
+
+void irqInit() {
+  irqSuspendAll();
+
+  if(!arm940IsThis()) {
+    REG32(INTMASK) = 0xFFFFFFFF;
+    REG32(INTMOD) = 0x0;
+    REG32(SRCPEND) = 0xFFFFFFFF;
+    REG32(INTPEND) = 0xFFFFFFFF;
+  }
+  for(int i = 0 ; i < 32 ; i++) {
+    handlers[i] = NULL;
+  }
+
+  orcus_setModeStack(MODE_IRQ, irqStack + IRQ_STACK_WORDS);
+  orcus_setModeStack(MODE_FIQ, fiqStack + FIQ_STACK_WORDS);
+
+  irqSetVector(VECTOR_IRQ, arm940IsThis() ? orcus_irq940Handler : orcus_irqHandler);
+  irqSetVector(VECTOR_FIQ, orcus_fiqHandler);
+
+  irqResume(0);
+}
+
+void irqSetHandler(InterruptSource source, IrqHandler handler) {
+  handlers[source] = handler;
+}
+
+void irqSetMode(InterruptSource source, InterruptMode mode) {
+  if(arm940IsThis()) {
+    return;
+  }
+  uint32_t state = irqSuspendAll();
+  REG32(INTMOD) = (REG32(INTMOD) & ~(1u << source)) | (mode == IRQ_MODE_FIQ ? 1u << source : 0);
+  irqResume(state);
+}
+
+ExceptionHandler irqSetVector(ExceptionVector vector, ExceptionHandler handler) {
+  r32* vectors[] = {
+		    &_undefined_instruction,
+		    &_software_interrupt,
+		    &_prefetch_abort,
+		    &_data_abort,
+		    &_irq,
+		    &_fiq
+  };
+
+  ExceptionHandler previous = (ExceptionHandler) *vectors[vector];
+  *vectors[vector] = (r32) handler;
+  return previous;
+}
+
+void irqEnable(InterruptSource source) {
+  if(arm940IsThis()) {
+    return;
+  }
+  uint32_t state = irqSuspendAll();
+  REG32(INTMASK) &= ~(1u << source);
+  irqResume(state);
+}
+
+void irqDisable(InterruptSource source) {
+  if(arm940IsThis()) {
+    return;
+  }
+  uint32_t state = irqSuspendAll();
+  REG32(INTMASK) |= 1u << source;
+  irqResume(state);
+}
+
+static inline uint32_t orcus_setCpsrBits(uint32_t bits) {
+  uint32_t cpsr;
+  asm volatile("mrs %0, cpsr\n"
+	       "orr r1, %0, %1\n"
+	       "msr cpsr_c, r1"
+	       : "=&r"(cpsr) : "r"(bits) : "r1", "memory");
+  return cpsr;
+}
+
+uint32_t irqSuspend() {
+  return orcus_setCpsrBits(CPSR_I);
+}
+
+uint32_t irqSuspendAll() {
+  return orcus_setCpsrBits(CPSR_I | CPSR_F);
+}
+
+void irqResume(uint32_t state) {
+  uint32_t cpsr;
+  asm volatile("mrs %0, cpsr\n"
+	       "bic %0, %0, %2\n"
+	       "orr %0, %0, %1\n"
+	       "msr cpsr_c, %0"
+	       : "=&r"(cpsr) : "r"(state & (CPSR_I | CPSR_F)), "I"(CPSR_I | CPSR_F) : "memory");
+}
+
+void irqWaitForInterrupt() {
+  if(arm940IsThis()) {
+    asm volatile("mov r0, #0\n"
+		 "mcr p15, 0, r0, c15, c8, 2"
+		 : : : "r0", "memory");
+  } else {
+    asm volatile("mov r0, #0\n"
+		 "mcr p15, 0, r0, c7, c0, 4"
+		 : : : "r0", "memory");
+  }
+}
@@ -0,0 +1,165 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <malloc.h>
+#include <stddef.h>
+
+/*
+  Jobs go through a ring buffer in ARM940T memory, in the same way as the audio service's commands. Completion is
+  a count of finished jobs in the data registers, so a ticket is just the value the count reaches when its job is
+  done. The ARM940T writes the high half last, and that write is the one which can interrupt the ARM920T.
+
+  Registers are kept clear of the ones used by audio940.c and mailbox.c.
+
+  arm940Data (written by the ARM920T)
+  8 - doorbell, incremented after jobs are posted
+
+  arm920Data (written by the ARM940T)
+  8 - WORKER_READY once the worker is running, or WORKER_FAILED if it couldn't allocate the job ring
+  9 - job ring address low
+  10 - job ring address high
+  11 - finished count low
+  12 - finished count high
+*/
+#define WORKER_READY 0x10B5
+#define WORKER_FAILED 0x10BF
+#define QUEUE_LENGTH 64
+#define JOB_BATCH 8
+
+#define REG_DOORBELL 8
+#define REG_READY 8
+#define REG_QUEUE_LOW 9
+#define REG_QUEUE_HIGH 10
+#define REG_DONE_LOW 11
+#define REG_DONE_HIGH 12
+
+static RingBuffer jobRing;
+
+// ARM940T
+
+static JobFunction functions[JOB_FUNCTIONS];
+
+void jobRegister(int function, JobFunction fn) {
+  functions[function] = fn;
+}
+
+int jobWorker() {
+  void* ringMemory = memalign(32, ringMemorySize(sizeof(Job), QUEUE_LENGTH));
+  if(ringMemory == NULL) {
+    arm920Data[REG_READY] = WORKER_FAILED;
+    return 1;
+  }
+  ringInit(&jobRing, ringMemory, sizeof(Job), QUEUE_LENGTH);
+
+  uint16_t doorbell = arm940Data[REG_DOORBELL];
+  uint32_t done = 0;
+  uint32_t ringAddr = (uint32_t)ringMemory; // the ARM920T imports it
+  arm920Data[REG_DONE_LOW] = 0;
+  arm920Data[REG_DONE_HIGH] = 0;
+  arm920Data[REG_QUEUE_LOW] = ringAddr & 0xFFFF;
+  arm920Data[REG_QUEUE_HIGH] = ringAddr >> 16;
+  arm920Data[REG_READY] = WORKER_READY;
+
+  while(1) {
+    if(arm940Data[REG_DOORBELL] == doorbell) {
+      continue;
+    }
+    doorbell = arm940Data[REG_DOORBELL];
+
+    Job jobs[JOB_BATCH];
+    for(int count ; (count = ringRead(&jobRing, jobs, JOB_BATCH)) > 0 ; ) {
+      for(int i = 0 ; i < count ; i++) {
+	uint32_t fn = jobs[i].function;
+	if(fn < JOB_FUNCTIONS && functions[fn] != NULL) {
+	  functions[fn](jobs[i].args[0], jobs[i].args[1], jobs[i].args[2], jobs[i].args[3]);
+	}
+
+	// results have to reach memory before the ARM920T is told the job is done
+	cacheDrainWriteBuffer();
+	done++;
+	arm920Data[REG_DONE_LOW] = done & 0xFFFF;
+	arm920Data[REG_DONE_HIGH] = done >> 16;
+      }
+    }
+  }
+}
+
+// ARM920T
+
+static JobTicket submitted = 0;
+static bool useInterrupts = false;
+
+// nothing to do, the interrupt is only there to wake jobWait()
+static void job_finishedHandler() {
+}
+
+// the two halves are written separately, so read the high half either side of the low half until they match
+static uint32_t job_doneCount() {
+  uint16_t high, low;
+  do {
+    high = arm920Data[REG_DONE_HIGH];
+    low = arm920Data[REG_DONE_LOW];
+  } while(high != arm920Data[REG_DONE_HIGH]);
+  return ((uint32_t)high << 16) | low;
+}
+
+int jobConnect(unsigned long timeoutNs) {
+  uint32_t start = timerGet();
+  while(arm920Data[REG_READY] != WORKER_READY) {
+    if(arm920Data[REG_READY] == WORKER_FAILED || timerNsSince(start, NULL) > timeoutNs) {
+      return 1;
+    }
+  }
+
+  ringAttach(&jobRing, importPointer(arm920Data[REG_QUEUE_LOW] | (arm920Data[REG_QUEUE_HIGH] << 16)));
+  submitted = job_doneCount();
+  return 0;
+}
+
+void jobUseInterrupts(bool enable) {
+  arm940SetDataHandler(REG_DONE_HIGH, enable ? job_finishedHandler : NULL);
+  useInterrupts = enable;
+}
+
+JobTicket jobSubmit(int function, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+  Job job = {
+	     .function = function,
+	     .args = { arg0, arg1, arg2, arg3 }
+  };
+  while(!ringPush(&jobRing, &job)); // queue full, the ARM940T is behind
+  arm940Data[REG_DOORBELL]++;
+  return ++submitted;
+}
+
+JobTicket jobSubmitBatch(const Job* jobs, int count) {
+  while(count > 0) {
+    int written = ringWrite(&jobRing, jobs, count);
+    if(written > 0) {
+      arm940Data[REG_DOORBELL]++;
+      submitted += written;
+      jobs += written;
+      count -= written;
+    }
+  }
+  return submitted;
+}
+
+bool jobIsDone(JobTicket ticket) {
+  return (int32_t)(job_doneCount() - ticket) >= 0;
+}
+
+void jobWait(JobTicket ticket) {
+  while(!jobIsDone(ticket)) {
+    if(useInterrupts) {
+      // check again with IRQs off so the completion can't slip in between the check and the wait
+      uint32_t state = irqSuspend();
+      if(!jobIsDone(ticket)) {
+	irqWaitForInterrupt();
+      }
+      irqResume(state);
+    }
+  }
+}
+
+void jobWaitAll() {
+  jobWait(submitted);
+}
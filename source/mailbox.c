@@ -0,0 +1,119 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <malloc.h>
+#include <stddef.h>
+
+/*
+  A ring buffer in each direction, both in ARM940T memory. Posting a message writes it to the outgoing ring then
+  bumps a doorbell in the other CPU's data registers, and the write to that register interrupts the other CPU. The
+  receiving side clears the interrupt before draining its ring, so a message posted while it is draining raises the
+  interrupt again rather than being left behind. Draining happens in the interrupt handler, which is only safe
+  because the ring never drops data cache lines without cleaning them first.
+
+  Registers are kept clear of the ones used by audio940.c and jobs.c.
+
+  arm940Data (written by the ARM920T)
+  4 - doorbell, incremented after a message is posted to the ARM940T
+
+  arm920Data (written by the ARM940T)
+  4 - MAILBOX_READY once the queues are set up, or MAILBOX_FAILED if they couldn't be allocated
+  5 - queue address low
+  6 - queue address high
+  7 - doorbell, incremented after a message is posted to the ARM920T
+*/
+#define MAILBOX_READY 0x3A11
+#define MAILBOX_FAILED 0x3A1F
+#define QUEUE_LENGTH 32
+#define MESSAGE_BATCH 8
+
+#define REG_DOORBELL_940 4
+#define REG_READY 4
+#define REG_QUEUE_LOW 5
+#define REG_QUEUE_HIGH 6
+#define REG_DOORBELL_920 7
+
+typedef struct {
+  uint32_t type;
+  uint32_t args[3];
+} MailboxMessage;
+
+static MailboxHandler handlers[MAILBOX_TYPES];
+static RingBuffer incoming;
+static RingBuffer outgoing;
+
+static void mailbox_receive() {
+  MailboxMessage messages[MESSAGE_BATCH];
+  for(int count ; (count = ringRead(&incoming, messages, MESSAGE_BATCH)) > 0 ; ) {
+    for(int i = 0 ; i < count ; i++) {
+      uint32_t type = messages[i].type;
+      if(type < MAILBOX_TYPES && handlers[type] != NULL) {
+	handlers[type](messages[i].args[0], messages[i].args[1], messages[i].args[2]);
+      }
+    }
+  }
+}
+
+int mailboxInit() {
+  uint32_t queueSize = ringMemorySize(sizeof(MailboxMessage), QUEUE_LENGTH);
+  uint8_t* memory = (uint8_t*) memalign(32, queueSize*2);
+  if(memory == NULL) {
+    arm920Data[REG_READY] = MAILBOX_FAILED;
+    return 1;
+  }
+
+  // the first queue carries messages to the ARM940T, the second to the ARM920T
+  ringInit(&incoming, memory, sizeof(MailboxMessage), QUEUE_LENGTH);
+  ringInit(&outgoing, memory + queueSize, sizeof(MailboxMessage), QUEUE_LENGTH);
+  arm940SetDataHandler(REG_DOORBELL_940, mailbox_receive);
+
+  uint32_t queueAddr = (uint32_t)memory; // the ARM920T imports it
+  arm920Data[REG_QUEUE_LOW] = queueAddr & 0xFFFF;
+  arm920Data[REG_QUEUE_HIGH] = queueAddr >> 16;
+  arm920Data[REG_READY] = MAILBOX_READY;
+  return 0;
+}
+
+int mailboxConnect(unsigned long timeoutNs) {
+  uint32_t start = timerGet();
+  while(arm920Data[REG_READY] != MAILBOX_READY) {
+    if(arm920Data[REG_READY] == MAILBOX_FAILED || timerNsSince(start, NULL) > timeoutNs) {
+      return 1;
+    }
+  }
+
+  uint8_t* memory = (uint8_t*) importPointer(arm920Data[REG_QUEUE_LOW] | (arm920Data[REG_QUEUE_HIGH] << 16));
+  uint32_t queueSize = ringMemorySize(sizeof(MailboxMessage), QUEUE_LENGTH);
+  ringAttach(&outgoing, memory);
+  ringAttach(&incoming, memory + queueSize);
+
+  // pick up anything the ARM940T posted before the interrupt was on
+  uint32_t state = irqSuspend();
+  arm940SetDataHandler(REG_DOORBELL_920, mailbox_receive);
+  mailbox_receive();
+  irqResume(state);
+  return 0;
+}
+
+void mailboxSetHandler(int type, MailboxHandler handler) {
+  handlers[type] = handler;
+}
+
+int mailboxPost(int type, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+  MailboxMessage message = {
+			    .type = type,
+			    .args = { arg0, arg1, arg2 }
+  };
+
+  // handlers can post too, so keep them out while this one goes in
+  uint32_t state = irqSuspendAll();
+  bool posted = ringPush(&outgoing, &message);
+  if(posted) {
+    if(arm940IsThis()) {
+      arm920Data[REG_DOORBELL_920]++;
+    } else {
+      arm940Data[REG_DOORBELL_940]++;
+    }
+  }
+  irqResume(state);
+  return posted ? 0 : 1;
+}
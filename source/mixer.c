@@ -0,0 +1,290 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <string.h>
+
+/*
+  Voices are mixed into a 32-bit accumulator a chunk at a time (left and right interleaved), which is then
+  saturated down to 16 bits and packed two samples to a word. The ARM versions of the two inner loops are written
+  for the ARM920T (ARMv4T) - there is no QADD, so saturation uses conditional execution instead of branches. The C
+  versions are the reference and are used when building for anything else.
+*/
+#define CHUNK_FRAMES 256
+#define DEFAULT_RATE 44100
+#define STEP_ONE 0x10000 // voice steps are 16.16 fixed point, in source samples per output sample
+#define MAX_RUN 0x7FFF // longest run a resampling kernel is given, so its 16.16 position can't overflow
+
+typedef struct {
+  const void* data;
+  int length;
+  int position;
+  uint32_t fraction;
+  uint32_t step;
+  int rate;
+  MixerFormat format;
+  bool loop;
+  bool playing;
+  int volume;
+  int pan;
+} MixerVoice;
+
+static MixerVoice voices[MIXER_VOICES] = {
+  [0 ... MIXER_VOICES-1] = { .volume = MIXER_UNITY, .pan = MIXER_CENTRE, .rate = DEFAULT_RATE, .step = STEP_ONE }
+};
+static int outputRate = DEFAULT_RATE;
+static int32_t accumulator[CHUNK_FRAMES*2];
+
+#if defined(__arm__)
+
+static void mixer_mix16(int32_t* acc, const int16_t* src, int frames, int gainLeft, int gainRight) {
+  asm volatile("1:\n"
+	       "ldrsh r4, [%[src]], #2\n"
+	       "ldmia %[acc], {r5, r6}\n"
+	       "mla r5, r4, %[gainLeft], r5\n"
+	       "mla r6, r4, %[gainRight], r6\n"
+	       "stmia %[acc]!, {r5, r6}\n"
+	       "subs %[frames], %[frames], #1\n"
+	       "bgt 1b"
+	       : [acc] "+r" (acc), [src] "+r" (src), [frames] "+r" (frames)
+	       : [gainLeft] "r" (gainLeft), [gainRight] "r" (gainRight)
+	       : "r4", "r5", "r6", "cc", "memory");
+}
+
+static void mixer_mix8(int32_t* acc, const int8_t* src, int frames, int gainLeft, int gainRight) {
+  asm volatile("1:\n"
+	       "ldrsb r4, [%[src]], #1\n"
+	       "ldmia %[acc], {r5, r6}\n"
+	       "mla r5, r4, %[gainLeft], r5\n"
+	       "mla r6, r4, %[gainRight], r6\n"
+	       "stmia %[acc]!, {r5, r6}\n"
+	       "subs %[frames], %[frames], #1\n"
+	       "bgt 1b"
+	       : [acc] "+r" (acc), [src] "+r" (src), [frames] "+r" (frames)
+	       : [gainLeft] "r" (gainLeft << 8), [gainRight] "r" (gainRight << 8)
+	       : "r4", "r5", "r6", "cc", "memory");
+}
+
+// x >> 15 and x >> 31 differ only when x doesn't fit in 16 bits, in which case 0x7FFF ^ sign gives the limit
+static void mixer_pack(uint32_t* out, const int32_t* acc, int frames) {
+  asm volatile("1:\n"
+	       "ldmia %[acc]!, {r4, r5}\n"
+	       "mov r4, r4, asr #8\n"
+	       "mov r5, r5, asr #8\n"
+	       "mov r6, r4, asr #15\n"
+	       "teq r6, r4, asr #31\n"
+	       "eorne r4, %[max], r4, asr #31\n"
+	       "mov r6, r5, asr #15\n"
+	       "teq r6, r5, asr #31\n"
+	       "eorne r5, %[max], r5, asr #31\n"
+	       "mov r4, r4, lsl #16\n"
+	       "mov r4, r4, lsr #16\n"
+	       "orr r4, r4, r5, lsl #16\n"
+	       "str r4, [%[out]], #4\n"
+	       "subs %[frames], %[frames], #1\n"
+	       "bgt 1b"
+	       : [out] "+r" (out), [acc] "+r" (acc), [frames] "+r" (frames)
+	       : [max] "r" (0x7FFF)
+	       : "r4", "r5", "r6", "cc", "memory");
+}
+
+#else
+
+static void mixer_mix16(int32_t* acc, const int16_t* src, int frames, int gainLeft, int gainRight) {
+  for(int i = 0 ; i < frames ; i++) {
+    acc[0] += src[i] * gainLeft;
+    acc[1] += src[i] * gainRight;
+    acc += 2;
+  }
+}
+
+static void mixer_mix8(int32_t* acc, const int8_t* src, int frames, int gainLeft, int gainRight) {
+  for(int i = 0 ; i < frames ; i++) {
+    acc[0] += src[i] * (gainLeft << 8);
+    acc[1] += src[i] * (gainRight << 8);
+    acc += 2;
+  }
+}
+
+static inline int32_t mixer_saturate(int32_t x) {
+  return x > 0x7FFF ? 0x7FFF : (x < -0x8000 ? -0x8000 : x);
+}
+
+static void mixer_pack(uint32_t* out, const int32_t* acc, int frames) {
+  for(int i = 0 ; i < frames ; i++) {
+    uint32_t left = (uint16_t) mixer_saturate(acc[i*2] >> 8);
+    uint32_t right = (uint16_t) mixer_saturate(acc[i*2+1] >> 8);
+    out[i] = left | (right << 16);
+  }
+}
+
+#endif
+
+/*
+  Linear interpolation between neighbouring samples, used for voices which aren't at the output rate. position is
+  16.16 relative to src, and the kernels stop before the sample after the current one would be at or past end. The
+  fraction is dropped to 15 bits so the difference between two 16-bit samples can't overflow the multiply.
+*/
+static int mixer_resample16(int32_t* acc, const int16_t* src, int frames, uint32_t* position, uint32_t step, uint32_t end, int gainLeft, int gainRight) {
+  uint32_t pos = *position;
+  int i;
+  for(i = 0 ; i < frames && pos < end ; i++) {
+    const int16_t* s = src + (pos >> 16);
+    int32_t sample = s[0] + (((s[1] - s[0]) * (int32_t)((pos & 0xFFFF) >> 1)) >> 15);
+    acc[0] += sample * gainLeft;
+    acc[1] += sample * gainRight;
+    acc += 2;
+    pos += step;
+  }
+  *position = pos;
+  return i;
+}
+
+static int mixer_resample8(int32_t* acc, const int8_t* src, int frames, uint32_t* position, uint32_t step, uint32_t end, int gainLeft, int gainRight) {
+  uint32_t pos = *position;
+  int i;
+  for(i = 0 ; i < frames && pos < end ; i++) {
+    const int8_t* s = src + (pos >> 16);
+    int32_t sample = (s[0] << 8) + (((s[1] - s[0]) * (int32_t)(pos & 0xFFFF)) >> 8);
+    acc[0] += sample * gainLeft;
+    acc[1] += sample * gainRight;
+    acc += 2;
+    pos += step;
+  }
+  *position = pos;
+  return i;
+}
+
+static inline int32_t mixer_sample(MixerVoice* voice, int idx) {
+  return voice->format == MIXER_PCM16 ? ((const int16_t*)voice->data)[idx] : ((const int8_t*)voice->data)[idx] << 8;
+}
+
+// the last sample of the data, which interpolates towards the start when looping
+static void mixer_lastSample(MixerVoice* voice, int32_t* acc, int gainLeft, int gainRight) {
+  int32_t a = mixer_sample(voice, voice->position);
+  int32_t b = voice->loop ? mixer_sample(voice, 0) : a;
+  int32_t sample = a + (((b - a) * (int32_t)(voice->fraction >> 1)) >> 15);
+  acc[0] += sample * gainLeft;
+  acc[1] += sample * gainRight;
+
+  uint32_t pos = voice->fraction + voice->step;
+  voice->position += pos >> 16;
+  voice->fraction = pos & 0xFFFF;
+}
+
+static int mixer_resampleRun(MixerVoice* voice, int32_t* acc, int frames, int gainLeft, int gainRight) {
+  int run = voice->length - 1 - voice->position;
+  uint32_t end = (run > MAX_RUN ? MAX_RUN : run) << 16;
+  uint32_t pos = voice->fraction;
+  int count;
+
+  if(voice->format == MIXER_PCM16) {
+    count = mixer_resample16(acc, ((const int16_t*)voice->data) + voice->position, frames, &pos, voice->step, end, gainLeft, gainRight);
+  } else {
+    count = mixer_resample8(acc, ((const int8_t*)voice->data) + voice->position, frames, &pos, voice->step, end, gainLeft, gainRight);
+  }
+  voice->position += pos >> 16;
+  voice->fraction = pos & 0xFFFF;
+
+  if(count == 0) {
+    mixer_lastSample(voice, acc, gainLeft, gainRight);
+    count = 1;
+  }
+  return count;
+}
+
+static void mixer_voice(MixerVoice* voice, int32_t* acc, int frames) {
+  int gainLeft = (voice->volume * (voice->pan > MIXER_CENTRE ? 256 - voice->pan : MIXER_CENTRE)) / MIXER_CENTRE;
+  int gainRight = (voice->volume * (voice->pan < MIXER_CENTRE ? voice->pan : MIXER_CENTRE)) / MIXER_CENTRE;
+
+  while(frames > 0 && voice->playing) {
+    int count;
+    if(voice->step == STEP_ONE && voice->fraction == 0) {
+      count = voice->length - voice->position;
+      count = count > frames ? frames : count;
+
+      if(voice->format == MIXER_PCM16) {
+	mixer_mix16(acc, ((const int16_t*)voice->data) + voice->position, count, gainLeft, gainRight);
+      } else {
+	mixer_mix8(acc, ((const int8_t*)voice->data) + voice->position, count, gainLeft, gainRight);
+      }
+      voice->position += count;
+    } else {
+      count = mixer_resampleRun(voice, acc, frames, gainLeft, gainRight);
+    }
+    acc += count*2;
+    frames -= count;
+
+    if(voice->position >= voice->length) {
+      if(voice->loop) {
+	voice->position %= voice->length;
+      } else {
+	voice->position = 0;
+	voice->fraction = 0;
+	voice->playing = false;
+      }
+    }
+  }
+}
+
+static uint32_t mixer_step(int rate) {
+  uint32_t step = (((uint64_t)rate) << 16) / outputRate;
+  return step == 0 ? 1 : step;
+}
+
+void mixerPlay(int voice, const void* data, int length, MixerFormat format, bool loop) {
+  uint32_t state = irqSuspendAll();
+  voices[voice].data = data;
+  voices[voice].length = length;
+  voices[voice].position = 0;
+  voices[voice].fraction = 0;
+  voices[voice].format = format;
+  voices[voice].loop = loop;
+  voices[voice].playing = length > 0;
+  irqResume(state);
+}
+
+void mixerStop(int voice) {
+  voices[voice].playing = false;
+}
+
+bool mixerIsPlaying(int voice) {
+  return voices[voice].playing;
+}
+
+void mixerSetVolume(int voice, int volume, int pan) {
+  uint32_t state = irqSuspendAll();
+  voices[voice].volume = volume < 0 ? 0 : volume;
+  voices[voice].pan = pan < 0 ? 0 : (pan > 256 ? 256 : pan);
+  irqResume(state);
+}
+
+void mixerSetRate(int voice, int sampleRate) {
+  uint32_t state = irqSuspendAll();
+  voices[voice].rate = sampleRate;
+  voices[voice].step = mixer_step(sampleRate);
+  irqResume(state);
+}
+
+void mixerSetOutputRate(int sampleRate) {
+  uint32_t state = irqSuspendAll();
+  outputRate = sampleRate;
+  for(int i = 0 ; i < MIXER_VOICES ; i++) {
+    voices[i].step = mixer_step(voices[i].rate);
+  }
+  irqResume(state);
+}
+
+void mixerRender(void* buffer, int bytes) {
+  uint32_t* out = (uint32_t*) buffer;
+  int frames = bytes / 4;
+
+  while(frames > 0) {
+    int count = frames > CHUNK_FRAMES ? CHUNK_FRAMES : frames;
+    memset(accumulator, 0, count*2*sizeof(int32_t));
+    for(int i = 0 ; i < MIXER_VOICES ; i++) {
+      mixer_voice(&voices[i], accumulator, count);
+    }
+    mixer_pack(out, accumulator, count);
+    out += count;
+    frames -= count;
+  }
+}
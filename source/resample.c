@@ -0,0 +1,83 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+
+/*
+  Input frame k is interpolated with the frame before it, with frame -1 being the last frame of the previous call.
+  position is in input frames from frame -1. The fraction is dropped to 15 bits so the difference between two 16-bit
+  samples can't overflow the multiply.
+
+  Long blocks are worked through a run of at most MAX_RUN frames at a time, moving input along between runs, so the
+  16.16 position never needs more than 15 bits of whole frames and adding a step to it can't overflow.
+*/
+#define MAX_RUN 0x7FFF
+#define MAX_STEP 0x80000000
+static inline int16_t resample_lerp(int32_t a, int32_t b, uint32_t fraction) {
+  return a + (((b - a) * (int32_t)(fraction >> 1)) >> 15);
+}
+
+int resamplerInit(Resampler* resampler, int inputRate, int outputRate) {
+  if(inputRate <= 0 || outputRate <= 0) {
+    return 1;
+  }
+  uint64_t step = (((uint64_t)inputRate) << 16) / outputRate;
+  if(step > MAX_STEP) {
+    return 1;
+  }
+
+  resampler->step = step == 0 ? 1 : step;
+  resampler->position = 0x10000; // start exactly on the first input frame
+  resampler->previous[0] = 0;
+  resampler->previous[1] = 0;
+  return 0;
+}
+
+int resamplerProcess(Resampler* resampler, const int16_t* input, int inputFrames, int16_t* output, int outputFrames, int* inputUsed) {
+  uint32_t pos = resampler->position;
+  uint32_t step = resampler->step;
+  int produced = 0;
+
+  // first frame interpolates from the previous call
+  while(produced < outputFrames && inputFrames > 0 && pos < 0x10000) {
+    output[0] = resample_lerp(resampler->previous[0], input[0], pos);
+    output[1] = resample_lerp(resampler->previous[1], input[1], pos);
+    output += 2;
+    produced++;
+    pos += step;
+  }
+
+  // the rest only need the input
+  int consumed = 0; // input frames moved past, pos is relative to input + consumed
+  while(produced < outputFrames) {
+    int left = inputFrames - consumed;
+    uint32_t end = ((uint32_t)(left > MAX_RUN ? MAX_RUN : left)) << 16;
+    const int16_t* run = input + consumed*2;
+    while(produced < outputFrames && pos < end) {
+      const int16_t* frame = run + ((pos >> 16) - 1)*2;
+      uint32_t fraction = pos & 0xFFFF;
+      output[0] = resample_lerp(frame[0], frame[2], fraction);
+      output[1] = resample_lerp(frame[1], frame[3], fraction);
+      output += 2;
+      produced++;
+      pos += step;
+    }
+    if(left <= MAX_RUN || pos < end) {
+      break; // out of input or output
+    }
+
+    // move along, keeping the frame before the position
+    int skip = (pos >> 16) - 1;
+    skip = skip > left ? left : skip;
+    consumed += skip;
+    pos -= ((uint32_t)skip) << 16;
+  }
+
+  int used = consumed + (pos >> 16);
+  used = used > inputFrames ? inputFrames : used;
+  if(used > 0) {
+    resampler->previous[0] = input[(used-1)*2];
+    resampler->previous[1] = input[(used-1)*2+1];
+  }
+  resampler->position = pos - (((uint32_t)(used - consumed)) << 16);
+  *inputUsed = used;
+  return produced;
+}
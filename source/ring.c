@@ -0,0 +1,140 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <string.h>
+
+#define CACHE_LINE 32
+
+/*
+  Each end of the ring is on its own cache line and is only ever written by one CPU, so either side can clean or
+  invalidate its lines without throwing away something the other has written. Indices run freely and are masked
+  when used, so head == tail is empty and head - tail == entries is full.
+*/
+typedef struct {
+  volatile uint32_t head; // written by the producer
+  uint32_t headPad[7];
+  volatile uint32_t tail; // written by the consumer
+  uint32_t tailPad[7];
+  uint32_t entrySize;
+  uint32_t entries;
+  uint32_t infoPad[6];
+} RingShared;
+
+// write lines back so the other CPU sees them, the ARM940T is write-through so only has to drain the write buffer
+static void ring_clean(void* start, uint32_t bytes) {
+  if(arm940IsThis()) {
+    cacheDrainWriteBuffer();
+  } else {
+    cacheCleanRange(start, bytes);
+  }
+}
+
+/*
+  Drop lines so the next read comes from memory. Only the lines asked for may go - memory around the ring can be
+  write-back and hold dirty data, e.g. the stack of code interrupted by the mailbox - so on the ARM940T, which can
+  only work by index, this is a clean and invalidate rather than dropping the whole cache.
+*/
+static void ring_invalidate(void* start, uint32_t bytes) {
+  cacheInvalidateRange(start, bytes);
+}
+
+// rounded up to whole cache lines, so invalidating the last entries can't touch anything after the ring
+uint32_t ringMemorySize(int entrySize, int entries) {
+  return (sizeof(RingShared) + (entrySize*entries) + (CACHE_LINE-1)) & ~(CACHE_LINE-1);
+}
+
+int ringInit(RingBuffer* ring, void* memory, int entrySize, int entries) {
+  if(entrySize <= 0 || (entrySize & 0x3) || entries <= 0 || (entries & (entries - 1)) || (((uint32_t)memory) & (CACHE_LINE-1))) {
+    return 1;
+  }
+
+  RingShared* shared = (RingShared*) memory;
+  shared->head = 0;
+  shared->tail = 0;
+  shared->entrySize = entrySize;
+  shared->entries = entries;
+  ring_clean(shared, sizeof(RingShared));
+
+  ring->shared = shared;
+  ring->data = ((uint8_t*)memory) + sizeof(RingShared);
+  ring->entrySize = entrySize;
+  ring->mask = entries - 1;
+  return 0;
+}
+
+void ringAttach(RingBuffer* ring, void* memory) {
+  RingShared* shared = (RingShared*) memory;
+  ring_invalidate(shared, sizeof(RingShared));
+
+  ring->shared = shared;
+  ring->data = ((uint8_t*)memory) + sizeof(RingShared);
+  ring->entrySize = shared->entrySize;
+  ring->mask = shared->entries - 1;
+}
+
+// copy between the ring and a flat buffer, in up to two pieces if the range wraps
+static void ring_copy(RingBuffer* ring, uint32_t index, uint8_t* buffer, int count, bool toRing) {
+  while(count > 0) {
+    uint32_t slot = index & ring->mask;
+    int run = (ring->mask + 1) - slot;
+    run = run > count ? count : run;
+    uint8_t* entry = ring->data + (slot*ring->entrySize);
+    uint32_t bytes = run*ring->entrySize;
+
+    if(toRing) {
+      memcpy(entry, buffer, bytes);
+      ring_clean(entry, bytes);
+    } else {
+      ring_invalidate(entry, bytes);
+      memcpy(buffer, entry, bytes);
+    }
+    index += run;
+    buffer += bytes;
+    count -= run;
+  }
+}
+
+int ringWrite(RingBuffer* ring, const void* entries, int count) {
+  RingShared* shared = (RingShared*) ring->shared;
+  ring_invalidate((void*)&shared->tail, sizeof(uint32_t));
+  uint32_t head = shared->head;
+  uint32_t space = (ring->mask + 1) - (head - shared->tail);
+  count = count > (int)space ? (int)space : count;
+  if(count <= 0) {
+    return 0;
+  }
+
+  ring_copy(ring, head, (uint8_t*)entries, count, true);
+  shared->head = head + count; // entries are already in memory, so they can be published
+  ring_clean((void*)&shared->head, sizeof(uint32_t));
+  return count;
+}
+
+int ringRead(RingBuffer* ring, void* entries, int count) {
+  RingShared* shared = (RingShared*) ring->shared;
+  ring_invalidate((void*)&shared->head, sizeof(uint32_t));
+  uint32_t tail = shared->tail;
+  uint32_t waiting = shared->head - tail;
+  count = count > (int)waiting ? (int)waiting : count;
+  if(count <= 0) {
+    return 0;
+  }
+
+  ring_copy(ring, tail, (uint8_t*)entries, count, false);
+  shared->tail = tail + count;
+  ring_clean((void*)&shared->tail, sizeof(uint32_t));
+  return count;
+}
+
+bool ringPush(RingBuffer* ring, const void* entry) {
+  return ringWrite(ring, entry, 1) == 1;
+}
+
+bool ringPop(RingBuffer* ring, void* entry) {
+  return ringRead(ring, entry, 1) == 1;
+}
+
+int ringCount(RingBuffer* ring) {
+  RingShared* shared = (RingShared*) ring->shared;
+  ring_invalidate((void*)shared, sizeof(RingShared));
+  return shared->head - shared->tail;
+}
@@ -2,28 +2,63 @@
 #include <orcus.h>
 #include <stddef.h>
 #include <unistd.h>
+#include <malloc.h>
+#include <string.h>
 #include "disc_io.h"
 
 extern void orcus_delay(int loops);
+extern bool sd_cacheReadSectors(sec_t sector, sec_t numSectors, void* buffer);
+extern bool sd_cacheWriteSectors(sec_t sector, sec_t numSectors, const void* buffer);
+extern bool sd_cacheFlush();
 
+#define SDI_CLOCK 74649600
 #define MMC_SPEED 10000000
-#define SD_SPEED 20000000
+#define SD_SPEED 25000000
+#define SD_HIGH_SPEED 50000000
+#define MMC_MAX_SPEED 20000000
 #define INITIAL_SD_SPEED 400000
+#define TUNING_CANDIDATES 3
 
 #define ILLEGAL_COMMAND BIT(22)
 
+#define SDIDAT_BASE (0xC0000000 + SDIDAT)
+#define FIFO_COUNT() (REG16(SDIFSTA)&0x7F)
+#define FIFO_SIZE 64
+#define DATA_TIMEOUT_NS 33750000
+#define DMA_MAX_BLOCKS 127 // a single DMA transfer is limited to 64K
+
+static int sdDmaChannel = -1;
 static uint16_t rca;
 static int sizeKb = -1;
 static bool isMMC = false;
 static bool isSDHC = false;
+static bool isWideBus = false;
+static bool isHighSpeed = false;
+static int clockHz = 0;
+
+// result of clock tuning for the last card seen, so that a reinit doesn't repeat it
+static uint16_t tunedCid[8];
+static int tunedClockHz = 0;
+static bool tunedHighSpeed = false;
 
 int sdSizeKb() {
   return sdIsInserted() ? sizeKb : -1;
 }
 
+// rounds the divider up, so the card is never clocked faster than asked for
 void sdSetClock(int hz) {
-  REG16(SDIPRE) = (74649600 / hz) - 1;
-  usleep(20000);
+  int divider = (SDI_CLOCK + hz - 1) / hz;
+  REG16(SDIPRE) = divider - 1;
+  clockHz = SDI_CLOCK / divider;
+  timerSleepNs(8 * (1000000000 / clockHz)); // let the card see a few cycles at the new rate
+}
+
+int sdClockSpeed() {
+  return clockHz;
+}
+
+bool sdIsHighSpeed() {
+  return isHighSpeed;
 }
 
 static int sd_cmd(uint8_t command, uint32_t arg, bool awaitResponse, bool isLongResponse, bool ignoreCrc) {
@@ -99,12 +134,103 @@ uint32_t cmd13() {
 }
 
 
+// single block read which doesn't need a CMD12, e.g. the 64 byte CMD6 status or a CMD17 test read
+static int sd_readShortBlock(uint8_t command, uint32_t arg, int bytes, uint32_t* dest) {
+  int result = 0;
+
+  REG16(SDICmdSta) = 0xFFFF;
+  REG16(SDIDatSta) = 0x07FF;
+  REG16(SDIBSize) = bytes;
+  REG16(SDIDatConL) = SDIDatConL_DAT_MODE(2) | SDIDatConL_BLK_NUM(1);
+  REG16(SDIDatConH) = 0x000A | SDIDatConH_WIDE_BUS(isWideBus ? 1 : 0);
+  REG16(SDICON) |= BIT(1);
+
+  if(sd_cmd(command, arg, true, false, false)) {
+    result = 1;
+  } else {
+    uint32_t currentTimer = timerGet();
+    for(int i = 0 ; i < bytes/4 && !result ; i++) {
+      while(FIFO_COUNT() < 4) {
+	if(timerNsSince(currentTimer, NULL) > DATA_TIMEOUT_NS) {
+	  result = 2;
+	  break;
+	}
+      }
+      if(!result) {
+	dest[i] = REG32(SDIDAT);
+      }
+    }
+
+    while(!result && !(REG16(SDIDatSta) & (SDIDatSta_DAT_FIN | SDIDatSta_DAT_TOUT | SDIDatSta_DAT_CRC))) {
+      if(timerNsSince(currentTimer, NULL) > DATA_TIMEOUT_NS) {
+	result = 2;
+      }
+    }
+    if(!result && (REG16(SDIDatSta) & (SDIDatSta_DAT_TOUT | SDIDatSta_DAT_CRC))) {
+      result = 3;
+    }
+  }
+
+  REG16(SDIDatConL) = SDIDatConL_STOP;
+  REG16(SDICON) |= BIT(1);
+  REG16(SDIBSize) = 512;
+  REG16(SDIDatConL) = 0xFFFF;
+  REG16(SDIDatConH) = 0xFFFF;
+  return result;
+}
+
+/*
+  Find the fastest clock the card and board can manage. SD cards which implement CMD6 are switched to high speed
+  mode first. Candidate dividers of the SDI clock are then tried from fastest down, each verified by reading block 0
+  and comparing it (along with the CRC check done by the controller) against a copy read at a conservative speed.
+*/
+static void sd_tuneClock() {
+  static uint32_t reference[128];
+  static uint32_t test[128];
+  int maxHz = isMMC ? MMC_MAX_SPEED : SD_SPEED;
+
+  sdSetClock(MMC_SPEED);
+
+  if(!isMMC) {
+    uint32_t status[16];
+    uint8_t* statusBytes = (uint8_t*) status;
+    // check mode first, byte 13 bit 1 is set if group 1 function 1 (high speed) is supported
+    if(!sd_readShortBlock(6, 0x00FFFFF1, 64, status) && (statusBytes[13] & BIT(1))
+       && !sd_readShortBlock(6, 0x80FFFFF1, 64, status) && (statusBytes[16] & 0xF) == 1) {
+      isHighSpeed = true;
+      maxHz = SD_HIGH_SPEED;
+    }
+  }
+
+  if(sd_readShortBlock(17, 0, 512, reference)) {
+    sdSetClock(isMMC ? MMC_SPEED : SD_SPEED);
+    return;
+  }
+
+  int divider = (SDI_CLOCK + maxHz - 1) / maxHz;
+  for(int i = 0 ; i < TUNING_CANDIDATES ; i++, divider++) {
+    sdSetClock(SDI_CLOCK / divider);
+    if(!sd_readShortBlock(17, 0, 512, test) && !memcmp(reference, test, sizeof(test))) {
+      return;
+    }
+  }
+
+  sdSetClock(MMC_SPEED);
+}
+
+int sdBusWidth() {
+  return isWideBus ? 4 : 1;
+}
+
 int sdInit() {
   isSDHC = false;
   isMMC = false;
+  isWideBus = false;
+  isHighSpeed = false;
   sdSetClock(INITIAL_SD_SPEED);
+  usleep(20000); // power up
   REG16(SDIDatConL) = 0x4000; // make sure all Rx/Tx is halted before we go any further
-  REG16(SDICON) = SDICON_BYT_ORDER | BIT(1) | SDICON_ENCLK(1);
+  REG16(SDICON) = BIT(1) | SDICON_ENCLK(1); // FIFO is always accessed a word at a time, so keep the first byte in D[7:0]
   REG16(SDIDTimerL) = 0xFFFF;
   REG16(SDIDTimerH) = 0x001F;
   REG16(SDIBSize) = 512;
@@ -144,6 +270,10 @@ int sdInit() {
 
  IS_READY:
   while(sd_cmd(2, 0, true, true, false));
+  uint16_t cid[8];
+  for(int i = 0 ; i < 8 ; i++) {
+    cid[i] = REG16(SDIRSP0 + (i*2));
+  }
   while(sd_cmd(3, 0, true, false, false));
 
   if(isMMC)
@@ -163,113 +293,655 @@ int sdInit() {
     return 5;
   }
 
+  // all SD cards should support a 4-bit bus (ACMD6), but stay on 1-bit if the card refuses, MMC does not have ACMD6
+  if(!isMMC
+     && !sd_cmd(55, (rca << 16), true, false, false)
+     && !sd_cmd(6, 0x2, true, false, false)
+     && !(r1() & (ILLEGAL_COMMAND | BIT(19)))) {
+    isWideBus = true;
+  }
+
+  if(tunedClockHz != 0 && !memcmp(cid, tunedCid, sizeof(cid))) {
+    // same card as last time, go straight to the clock we found then
+    if(tunedHighSpeed) {
+      uint32_t status[16];
+      isHighSpeed = !sd_readShortBlock(6, 0x80FFFFF1, 64, status) && (((uint8_t*)status)[16] & 0xF) == 1;
+    }
+    sdSetClock(isHighSpeed || !tunedHighSpeed ? tunedClockHz : SD_SPEED);
+  } else {
+    sd_tuneClock();
+    memcpy(tunedCid, cid, sizeof(cid));
+    tunedClockHz = clockHz;
+    tunedHighSpeed = isHighSpeed;
+  }
+
   return 0;
 }
 
-int sdReadBlocks(int startBlock, int numberOfBlocks, uint8_t* dest) {
-  int attempts = 0;
+void sdSetDmaChannel(int channel) {
+  sdDmaChannel = channel;
+  if(channel >= 0) {
+    dmaConfigureChannelFromIO(channel, WORDS_4, 0, 1, SDI);
+  }
+}
+
+/*
+  Request queue
+
+  Requests are kept in a singly linked list owned by the caller, the head of the list is the request currently being
+  worked on. Each request is carried out as one or more segments, where a segment is a single CMD18/CMD25 followed
+  by a CMD12.
+*/
+#define MAX_BLOCKS 4095 // size of the block count in SDIDatCon
+#define MAX_ATTEMPTS 5
+
+#define SEGMENT_DONE 0
+#define SEGMENT_RUNNING 1
+#define SEGMENT_TIMEOUT 2
+
+#define START_RETRY -1
+#define RETRY_DELAY_NS 20000000
+
+static SdRequest* queueHead = NULL;
+static SdRequest* queueTail = NULL;
+
+static bool useInterrupts = false;
+static bool isAdvancing = false;
+static bool segmentActive = false;
+static bool segmentUsesDma;
+static volatile int segmentStatus;
+static int segmentBlocks;
+static int blocksDone;
+static int attempts;
+static int pioOffset;
+static uint32_t lastProgress;
+static uint32_t lastRemaining;
+static volatile bool retryPending = false;
+static bool retryChecked;
+static uint32_t retryStart;
+
+#define SEGMENT_ERROR_INTERRUPTS (SDIIntEnL_DAT_FIN | SDIIntEnL_DAT_TOUT | SDIIntEnL_DAT_CRC)
+
+static uint16_t sd_segmentInterrupts(SdRequest* request) {
+  if(segmentUsesDma) {
+    return SEGMENT_ERROR_INTERRUPTS;
+  } else if(request->operation == SD_READ) {
+    return SEGMENT_ERROR_INTERRUPTS | SDIIntEnL_RF_HALF | SDIIntEnL_RF_LAST;
+  } else {
+    return SEGMENT_ERROR_INTERRUPTS | SDIIntEnL_TF_HALF;
+  }
+}
+
+static int sd_startSegment(SdRequest* request) {
+  bool isRead = request->operation == SD_READ;
+  int remaining = request->numberOfBlocks - blocksDone;
+  uint8_t* data = request->buffer + (blocksDone*512);
 
- CMD18:
+  segmentUsesDma = isRead && sdDmaChannel >= 0 && !(((uint32_t)data) & 0x3);
+  int maxBlocks = segmentUsesDma ? DMA_MAX_BLOCKS : MAX_BLOCKS;
+  segmentBlocks = remaining > maxBlocks ? maxBlocks : remaining;
+  int block = request->startBlock + blocksDone;
+
+  if(segmentUsesDma) {
+    cacheCleanInvalidateRange(data, segmentBlocks*512); // make sure no dirty lines get written back over the incoming data
+  }
   REG16(SDICmdSta) = 0xFFFF;
   REG16(SDIDatSta) = 0x07FF;
-  REG16(SDIDatConL) = (2 << 12) | numberOfBlocks;
-  REG16(SDIDatConH) = 0x000A;
-  REG16(SDICON) |= BIT(1); // clear the FIFO before we try to read
-  
-  if(sd_cmd(18, startBlock*(isSDHC ? 1 : 512), true, false, false)) {
-    if(cmd13()&0x400000) { // sometimes the card seems to get confused and stuck in data mode, reinit if we start getting illegal command responses
-      sdInit();
+  REG16(SDIDatConL) = (segmentUsesDma ? SDIDatConL_DMA_EN : 0)
+    | SDIDatConL_DAT_MODE(isRead ? 2 : 3)
+    | SDIDatConL_BLK_NUM(segmentBlocks);
+  REG16(SDIDatConH) = (isRead ? 0x000A : 0x0012) | SDIDatConH_WIDE_BUS(isWideBus ? 1 : 0);
+  REG16(SDICON) |= BIT(1); // clear the FIFO before we start
+  if(segmentUsesDma) {
+    dmaStart(sdDmaChannel, segmentBlocks*512, SDIDAT_BASE, (uint32_t)data);
+  }
+
+  if(sd_cmd(isRead ? 18 : 25, block*(isSDHC ? 1 : 512), true, false, false)) {
+    if(segmentUsesDma) {
+      dmaStop(sdDmaChannel);
     }
-    if(attempts > 5) {
+    if(attempts > MAX_ATTEMPTS) {
       return 1;
-    } else {
-      attempts++;
-      usleep(20000);
-      goto CMD18;
+    }
+    attempts++;
+
+    // this may be the interrupt handler, so recovering the card and backing off is left to sdProcess() and sdWait()
+    retryChecked = false;
+    retryStart = timerGet();
+    retryPending = true;
+    return START_RETRY;
+  }
+
+  REG16(SDICmdSta) = 0x1E00;
+  lastRemaining = REG32(SDIDatCnt);
+  lastProgress = timerGet();
+  pioOffset = 0;
+  segmentStatus = SEGMENT_RUNNING;
+  segmentActive = true;
+  if(useInterrupts) {
+    REG16(SDIIntEnL) = sd_segmentInterrupts(request);
+  }
+  return 0;
+}
+
+static int sd_stopSegment() {
+  segmentActive = false;
+  REG16(SDIIntEnL) = 0;
+
+  REG16(SDIDatConL) |= SDIDatConL_STOP;
+  REG16(SDICON) |= BIT(1);
+
+  if(sd_cmd(12, 0, true, false, false)) {
+    return 2;
+  }
+
+  REG16(SDICON) |= BIT(1);
+
+  REG16(SDIDatConL) = 0xFFFF;
+  REG16(SDIDatConH) = 0xFFFF;
+  return 0;
+}
+
+// a CRC error or timeout on the data lines, clearing it so the segment can be retried
+static bool sd_dataError() {
+  uint16_t status = REG16(SDIDatSta) & (SDIDatSta_DAT_TOUT | SDIDatSta_DAT_CRC);
+  if(status) {
+    REG16(SDIDatSta) = status;
+    return true;
+  }
+  return false;
+}
+
+// the DMA controller drains the FIFO, we only need to check that data is still arriving and arrived intact
+static int sd_dmaSegment(SdRequest* request) {
+  if(sd_dataError()) {
+    dmaStop(sdDmaChannel);
+    return SEGMENT_TIMEOUT;
+  }
+  if((REG16(SDIDatSta) & SDIDatSta_DAT_FIN) && dmaHasFinished(sdDmaChannel)) {
+    REG16(SDIDatSta) = SDIDatSta_DAT_FIN;
+    cacheInvalidateRange(request->buffer + (blocksDone*512), segmentBlocks*512);
+    return SEGMENT_DONE;
+  }
+
+  uint32_t remaining = REG32(SDIDatCnt);
+  if(remaining != lastRemaining) {
+    lastRemaining = remaining;
+    lastProgress = timerGet();
+  } else if(timerNsSince(lastProgress, NULL) > DATA_TIMEOUT_NS) {
+    dmaStop(sdDmaChannel);
+    return SEGMENT_TIMEOUT;
+  }
+  return SEGMENT_RUNNING;
+}
+
+// move as much data as the FIFO allows without waiting, returns true once the whole segment has been moved
+static bool sd_pioStep(SdRequest* request) {
+  uint8_t* data = request->buffer + (blocksDone*512);
+  int bytes = segmentBlocks*512; // TODO - handle different block sizes
+  bool isAligned = !(((uint32_t)data) & 0x3);
+
+  if(request->operation == SD_READ) {
+    for(int available = FIFO_COUNT() ; pioOffset < bytes && available >= 4 ; available -= 4, pioOffset += 4) {
+      uint32_t word = REG32(SDIDAT);
+      if(isAligned) {
+	*((uint32_t*)(data+pioOffset)) = word;
+      } else {
+	data[pioOffset] = word;
+	data[pioOffset+1] = word >> 8;
+	data[pioOffset+2] = word >> 16;
+	data[pioOffset+3] = word >> 24;
+      }
     }
   } else {
-    REG16(SDICmdSta) = 0x1E00;
-
-    for(int block = 0 ; block < numberOfBlocks ; block++) {
-      for(int byte = 0 ; byte < 512 ; byte++) { // TODO - handle different block sizes
-	uint32_t currentTimer = timerGet();
-	while((REG16(SDIFSTA)&0x7F) == 0) {
-	  if(timerNsSince(currentTimer, NULL) > 33750000) {
-	    goto CMD18;
-	  }
-	}
-	dest[(block*512)+byte] = REG8(SDIDAT);
+    for(int space = FIFO_SIZE - FIFO_COUNT() ; pioOffset < bytes && space >= 4 ; space -= 4, pioOffset += 4) {
+      REG32(SDIDAT) = isAligned ? *((uint32_t*)(data+pioOffset))
+	: data[pioOffset] | (data[pioOffset+1] << 8) | (data[pioOffset+2] << 16) | (data[pioOffset+3] << 24);
+    }
+  }
+  return pioOffset >= bytes;
+}
+
+static int sd_pioSegment(SdRequest* request) {
+  int offset = pioOffset;
+  uint32_t currentTimer = timerGet();
+  while(!sd_pioStep(request)) {
+    if(sd_dataError()) {
+      return SEGMENT_TIMEOUT;
+    }
+    if(pioOffset != offset) {
+      offset = pioOffset;
+      currentTimer = timerGet();
+    } else if(timerNsSince(currentTimer, NULL) > DATA_TIMEOUT_NS) {
+      return SEGMENT_TIMEOUT;
+    }
+  }
+
+  // the last block's CRC is only checked once it has all arrived
+  currentTimer = timerGet();
+  while(!(REG16(SDIDatSta) & (SDIDatSta_DAT_FIN | SDIDatSta_DAT_TOUT | SDIDatSta_DAT_CRC))) {
+    if(timerNsSince(currentTimer, NULL) > DATA_TIMEOUT_NS) {
+      return SEGMENT_TIMEOUT;
+    }
+  }
+  return sd_dataError() ? SEGMENT_TIMEOUT : SEGMENT_DONE;
+}
+
+// data finish has been signalled, check everything has made it to memory
+static int sd_finishSegment(SdRequest* request) {
+  if(segmentUsesDma) {
+    // the DMA controller may still be draining the last of the FIFO
+    uint32_t currentTimer = timerGet();
+    while(!dmaHasFinished(sdDmaChannel)) {
+      if(timerNsSince(currentTimer, NULL) > DATA_TIMEOUT_NS) {
+	dmaStop(sdDmaChannel);
+	return SEGMENT_TIMEOUT;
       }
     }
+    cacheInvalidateRange(request->buffer + (blocksDone*512), segmentBlocks*512);
+    return SEGMENT_DONE;
+  }
+  return sd_pioStep(request) ? SEGMENT_DONE : SEGMENT_TIMEOUT;
+}
 
-    REG16(SDIDatConL) |= BIT(14);
-    REG16(SDICON) |= BIT(1);
-    
-    if(sd_cmd(12, 0, true, false, false)) {
-      return 2;
+static void sd_completeRequest(SdRequest* request, int result) {
+  queueHead = request->next;
+  if(queueHead == NULL) {
+    queueTail = NULL;
+  }
+
+  request->result = result;
+  request->state = result ? SD_REQUEST_FAILED : SD_REQUEST_DONE;
+  if(request->callback != NULL) {
+    request->callback(request);
+  }
+}
+
+// callers must make sure this can't be interrupted by sd_irqHandler
+static void sd_advance() {
+  if(isAdvancing) {
+    return; // called from a completion callback, the outer loop will pick up anything new
+  }
+  isAdvancing = true;
+
+  while(queueHead != NULL) {
+    SdRequest* request = queueHead;
+
+    if(request->state == SD_REQUEST_QUEUED) {
+      request->state = SD_REQUEST_ACTIVE;
+      blocksDone = 0;
+      attempts = 0;
+    }
+
+    if(!segmentActive) {
+      if(retryPending) {
+	break;
+      }
+      if(blocksDone == request->numberOfBlocks) {
+	sd_completeRequest(request, 0);
+	continue;
+      }
+      int result = sd_startSegment(request);
+      if(result == START_RETRY) {
+	break;
+      } else if(result) {
+	sd_completeRequest(request, result);
+	continue;
+      }
     }
 
-    REG16(SDICON) |= BIT(1);
+    int status;
+    if(useInterrupts) {
+      status = segmentStatus;
+    } else {
+      status = segmentUsesDma ? sd_dmaSegment(request) : sd_pioSegment(request);
+    }
+    if(status == SEGMENT_RUNNING) {
+      break;
+    } else if(status == SEGMENT_TIMEOUT) {
+      segmentActive = false;
+      REG16(SDIIntEnL) = 0;
+      if(attempts++ > MAX_ATTEMPTS) {
+	sd_stopSegment();
+	sd_completeRequest(request, 1);
+      }
+      continue;
+    }
 
-    REG16(SDIDatConL) = 0xFFFF;
-    REG16(SDIDatConH) = 0xFFFF;
+    int result = sd_stopSegment();
+    if(result) {
+      sd_completeRequest(request, result);
+      continue;
+    }
+    blocksDone += segmentBlocks;
   }
 
-  return 0;
+  isAdvancing = false;
 }
 
-int sdWriteBlocks(int startBlock, int numberOfBlocks, uint8_t* src) {
-  int attempts = 0;
+static void sd_irqHandler() {
+  SdRequest* request = queueHead;
+  if(request == NULL || !segmentActive || segmentStatus != SEGMENT_RUNNING) {
+    REG16(SDIIntEnL) = 0;
+    return;
+  }
 
- CMD25:
-  REG16(SDICmdSta) = 0xFFFF;
-  REG16(SDIDatSta) = 0x07FF;
-  REG16(SDIDatConL) = (3 << 12) | numberOfBlocks;
-  REG16(SDIDatConH) = 0x0012;
-  REG16(SDICON) |= BIT(1); // clear the FIFO before we try to write
+  uint16_t status = REG16(SDIDatSta);
+  if(!segmentUsesDma && sd_pioStep(request)) {
+    REG16(SDIIntEnL) = SEGMENT_ERROR_INTERRUPTS; // no more FIFO work, only wait for the card to finish
+  }
+
+  if(status & (SDIDatSta_DAT_TOUT | SDIDatSta_DAT_CRC)) {
+    if(segmentUsesDma) {
+      dmaStop(sdDmaChannel);
+    }
+    segmentStatus = SEGMENT_TIMEOUT;
+  } else if(status & SDIDatSta_DAT_FIN) {
+    segmentStatus = sd_finishSegment(request);
+  }
+
+  if(segmentStatus != SEGMENT_RUNNING) {
+    REG16(SDIIntEnL) = 0;
+    REG16(SDIDatSta) = status;
+    sd_advance();
+  }
+}
+
+int sdSubmit(SdRequest* request) {
+  if(request->numberOfBlocks <= 0 || request->buffer == NULL) {
+    return 1;
+  }
+
+  request->state = SD_REQUEST_QUEUED;
+  request->result = 0;
+  request->next = NULL;
+
+  if(useInterrupts) {
+    irqDisable(IRQ_SD);
+  }
+  if(queueTail == NULL) {
+    queueHead = request;
+  } else {
+    queueTail->next = request;
+  }
+  queueTail = request;
+  if(useInterrupts) {
+    sd_advance(); // the interrupt handler takes it from here
+    irqEnable(IRQ_SD);
+  }
+  return 0;
+}
 
-  if(sd_cmd(25, startBlock*(isSDHC ? 1 : 512), true, false, false)) {
+// a segment failed to start, get the card back into shape and give it time before starting it again
+static void sd_retry() {
+  if(!retryChecked) {
+    retryChecked = true;
     if(cmd13()&0x400000) { // sometimes the card seems to get confused and stuck in data mode, reinit if we start getting illegal command responses
       sdInit();
     }
-    if(attempts > 5) {
-      return 1;
+  }
+  if(timerNsSince(retryStart, NULL) >= RETRY_DELAY_NS) {
+    retryPending = false;
+  }
+}
+
+void sdProcess() {
+  if(useInterrupts) {
+    irqDisable(IRQ_SD);
+  }
+  if(retryPending) {
+    sd_retry();
+  }
+  sd_advance();
+  if(useInterrupts) {
+    irqEnable(IRQ_SD);
+  }
+}
+
+void sdUseInterrupts(bool enable) {
+  while(sdIsBusy()) {
+    sdProcess();
+  }
+
+  if(enable) {
+    irqSetHandler(IRQ_SD, sd_irqHandler);
+    useInterrupts = true;
+    irqEnable(IRQ_SD);
+  } else {
+    irqDisable(IRQ_SD);
+    useInterrupts = false;
+    REG16(SDIIntEnL) = 0;
+  }
+}
+
+bool sdIsBusy() {
+  return queueHead != NULL;
+}
+
+int sdWait(SdRequest* request) {
+  while(request->state == SD_REQUEST_QUEUED || request->state == SD_REQUEST_ACTIVE) {
+    if(useInterrupts && !retryPending) {
+      // check again with IRQs off so the completion can't slip in between the check and the wait
+      uint32_t state = irqSuspend();
+      if((request->state == SD_REQUEST_QUEUED || request->state == SD_REQUEST_ACTIVE) && !retryPending) {
+	irqWaitForInterrupt();
+      }
+      irqResume(state);
     } else {
-      attempts++;
-      usleep(20000);
-      goto CMD25;
+      sdProcess();
     }
-  } else {
-    REG16(SDICmdSta) = 0x1E00;
-
-    for(int block = 0 ; block < numberOfBlocks ; block++) {
-      for(int byte = 0 ; byte < 512 ; byte++) { // TODO - handle different block sizes
-	uint32_t currentTimer = timerGet();
-	while((REG16(SDIFSTA)&0x2000) == 0) {
-	  if(timerNsSince(currentTimer, NULL) > 33750000) {
-	    goto CMD25;
-	  }
-	}
-	REG8(SDIDAT) = src[(block*512)+byte];
+  }
+  return request->result;
+}
+
+int sdReadBlocks(int startBlock, int numberOfBlocks, uint8_t* dest) {
+  SdRequest request = {
+		       .operation = SD_READ,
+		       .startBlock = startBlock,
+		       .numberOfBlocks = numberOfBlocks,
+		       .buffer = dest
+  };
+  if(sdSubmit(&request)) {
+    return 1;
+  }
+  return sdWait(&request);
+}
+
+int sdWriteBlocks(int startBlock, int numberOfBlocks, uint8_t* src) {
+  SdRequest request = {
+		       .operation = SD_WRITE,
+		       .startBlock = startBlock,
+		       .numberOfBlocks = numberOfBlocks,
+		       .buffer = src
+  };
+  if(sdSubmit(&request)) {
+    return 1;
+  }
+  return sdWait(&request);
+}
+
+/*
+  Read-ahead
+
+  Two windows of readAheadSectors each. Once reads are found to be sequential, a miss fills the current window and
+  a request for the following window is queued straight away, so that it runs in the background while the caller
+  works through the current one. Moving into the next window swaps the two and queues the one after it.
+*/
+typedef struct {
+  SdRequest request;
+  uint8_t* data;
+  sec_t start;
+  int count;
+  bool valid;
+} ReadAheadWindow;
+
+static ReadAheadWindow windows[2];
+static int currentWindow = 0;
+static int readAheadSectors = 0;
+static uint8_t* readAheadData = NULL;
+static sec_t nextSequentialSector = 0;
+static SdReadAheadStats readAheadStats;
+
+static bool sd_readAheadPending(ReadAheadWindow* window) {
+  return window->valid
+    && (window->request.state == SD_REQUEST_QUEUED || window->request.state == SD_REQUEST_ACTIVE);
+}
+
+static void sd_readAheadSettle(ReadAheadWindow* window) {
+  if(sd_readAheadPending(window)) {
+    sdWait(&window->request);
+  }
+  if(window->valid && window->request.result) {
+    window->valid = false;
+  }
+}
+
+static void sd_readAheadFetch(ReadAheadWindow* window, sec_t start) {
+  int count = readAheadSectors;
+  if(isSDHC && sizeKb > 0) { // only SDHC cards report a size we trust
+    sec_t totalSectors = sizeKb*2;
+    count = start >= totalSectors ? 0 : (totalSectors - start < count ? totalSectors - start : count);
+  }
+
+  window->valid = false;
+  if(count <= 0) {
+    return;
+  }
+
+  window->start = start;
+  window->count = count;
+  window->request = (SdRequest) {
+				 .operation = SD_READ,
+				 .startBlock = start,
+				 .numberOfBlocks = count,
+				 .buffer = window->data
+  };
+  if(!sdSubmit(&window->request)) {
+    window->valid = true;
+    readAheadStats.prefetched += count;
+    sdProcess(); // get it started, DMA reads carry on in the background
+  }
+}
+
+static ReadAheadWindow* sd_readAheadFind(sec_t sector) {
+  for(int i = 0 ; i < 2 ; i++) {
+    ReadAheadWindow* window = &windows[(currentWindow + i) & 1];
+    if(window->valid && sector >= window->start && sector < window->start + window->count) {
+      sd_readAheadSettle(window);
+      if(window->valid) {
+	return window;
       }
     }
+  }
+  return NULL;
+}
+
+bool sd_readAheadRead(sec_t sector, sec_t numSectors, void* buffer) {
+  uint8_t* dest = (uint8_t*) buffer;
+
+  if(readAheadSectors == 0 || numSectors >= readAheadSectors) {
+    nextSequentialSector = sector + numSectors;
+    return !sdReadBlocks(sector, numSectors, dest);
+  }
+
+  bool isSequential = sector == nextSequentialSector;
+  nextSequentialSector = sector + numSectors;
+
+  while(numSectors > 0) {
+    ReadAheadWindow* window = sd_readAheadFind(sector);
+    if(window == NULL) {
+      break;
+    }
+
+    int count = window->start + window->count - sector;
+    count = count > numSectors ? numSectors : count;
+    memcpy(dest, window->data + ((sector - window->start)*512), count*512);
+    readAheadStats.hits += count;
+    sector += count;
+    numSectors -= count;
+    dest += count*512;
+
+    if(window != &windows[currentWindow]) {
+      // moved on to the next window, the old one is done with so fetch the window after this one into it
+      ReadAheadWindow* old = &windows[currentWindow];
+      currentWindow ^= 1;
+      sd_readAheadSettle(old);
+      sd_readAheadFetch(old, window->start + window->count);
+    }
+  }
 
-    REG16(SDIDatConL) |= BIT(14);
-    REG16(SDICON) |= BIT(1);
+  if(numSectors == 0) {
+    return true;
+  }
+
+  readAheadStats.misses += numSectors;
+  if(!isSequential) {
+    return !sdReadBlocks(sector, numSectors, dest);
+  }
+
+  // refill both windows from here
+  ReadAheadWindow* current = &windows[currentWindow];
+  ReadAheadWindow* next = &windows[currentWindow ^ 1];
+  sd_readAheadSettle(current);
+  sd_readAheadSettle(next);
+  next->valid = false;
+
+  sd_readAheadFetch(current, sector);
+  sd_readAheadSettle(current);
+  if(!current->valid || current->count < numSectors) {
+    return !sdReadBlocks(sector, numSectors, dest);
+  }
+  memcpy(dest, current->data, numSectors*512);
+  sd_readAheadFetch(next, current->start + current->count);
+  return true;
+}
 
-    if(sd_cmd(12, 0, true, false, false)) {
-      return 2;
+bool sd_readAheadWrite(sec_t sector, sec_t numSectors, const void* buffer) {
+  // anything buffered for these sectors is about to be out of date
+  for(int i = 0 ; i < 2 ; i++) {
+    ReadAheadWindow* window = &windows[i];
+    if(window->valid && sector < window->start + window->count && sector + numSectors > window->start) {
+      sd_readAheadSettle(window);
+      window->valid = false;
     }
+  }
+  return !sdWriteBlocks(sector, numSectors, (uint8_t*) buffer);
+}
 
-    REG16(SDICON) |= BIT(1);
+int sdSetReadAhead(int sectors) {
+  for(int i = 0 ; i < 2 ; i++) {
+    sd_readAheadSettle(&windows[i]);
+    windows[i].valid = false;
+  }
+
+  free(readAheadData);
+  readAheadData = NULL;
+  readAheadSectors = 0;
+  sdReadAheadResetStats();
+
+  if(sectors <= 0) {
+    return 0;
+  }
 
-    REG16(SDIDatConL) = 0xFFFF;
-    REG16(SDIDatConH) = 0xFFFF;
+  readAheadData = (uint8_t*) memalign(32, 2*sectors*512);
+  if(readAheadData == NULL) {
+    return 1;
   }
 
+  windows[0].data = readAheadData;
+  windows[1].data = readAheadData + (sectors*512);
+  readAheadSectors = sectors;
   return 0;
 }
 
+void sdReadAheadGetStats(SdReadAheadStats* stats) {
+  *stats = readAheadStats;
+}
+
+void sdReadAheadResetStats() {
+  memset(&readAheadStats, 0, sizeof(readAheadStats));
+}
+
 bool sd_Startup() {
   return sdIsInserted() && !sdInit();
 }
@@ -279,19 +951,19 @@ bool sdIsInserted() {
 }
 
 bool sd_ReadSectors(sec_t sector, sec_t numSectors, void* buffer) {
-  return !sdReadBlocks(sector, numSectors, (uint8_t*) buffer);
+  return sd_cacheReadSectors(sector, numSectors, buffer);
 }
 
 bool sd_WriteSectors(sec_t sector, sec_t numSectors, const void* buffer) {
-  return !sdWriteBlocks(sector, numSectors, (uint8_t*) buffer);
+  return sd_cacheWriteSectors(sector, numSectors, buffer);
 }
 
 bool sd_ClearStatus() {
-  return true;
+  return sd_cacheFlush();
 }
 
 bool sd_Shutdown() {
-  return true;
+  return sd_cacheFlush();
 }
 
 #define DEVICE_TYPE_GP2X_SD ('_') | ('S' << 8) | ('D' << 16) | ('_' << 24)
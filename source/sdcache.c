@@ -0,0 +1,225 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <malloc.h>
+#include <string.h>
+#include "disc_io.h"
+
+extern bool sd_readAheadRead(sec_t sector, sec_t numSectors, void* buffer);
+extern bool sd_readAheadWrite(sec_t sector, sec_t numSectors, const void* buffer);
+
+/*
+  Write-back sector cache sitting between the libfat DISC_INTERFACE and the read-ahead layer in sd.c.
+
+  Small requests (FAT and directory sectors) go through the cache, large ones (file data) go straight to the card so
+  they don't evict everything else. Large requests still have to respect the cache - reads are patched with any
+  cached copy of a sector (which may be dirty), and writes update any cached copy.
+*/
+
+typedef struct {
+  sec_t sector;
+  uint32_t lastUsed;
+  bool valid;
+  bool dirty;
+} CacheEntry;
+
+static CacheEntry* entries = NULL;
+static uint8_t* cacheData = NULL;
+static int cacheSectors = 0;
+static uint32_t useCounter = 0;
+static SdCacheStats stats;
+
+static inline uint8_t* sd_cacheEntryData(int idx) {
+  return cacheData + (idx*512);
+}
+
+static int sd_cacheFind(sec_t sector) {
+  for(int i = 0 ; i < cacheSectors ; i++) {
+    if(entries[i].valid && entries[i].sector == sector) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static bool sd_cacheWriteBack(int idx) {
+  if(entries[idx].valid && entries[idx].dirty) {
+    if(!sd_readAheadWrite(entries[idx].sector, 1, sd_cacheEntryData(idx))) {
+      return false;
+    }
+    entries[idx].dirty = false;
+    stats.writeBacks++;
+  }
+  return true;
+}
+
+// find an empty entry, or write back and reuse the least recently used one
+static int sd_cacheVictim() {
+  int victim = 0;
+  for(int i = 0 ; i < cacheSectors ; i++) {
+    if(!entries[i].valid) {
+      return i;
+    }
+    if(entries[i].lastUsed < entries[victim].lastUsed) {
+      victim = i;
+    }
+  }
+
+  if(!sd_cacheWriteBack(victim)) {
+    return -1;
+  }
+  stats.evictions++;
+  entries[victim].valid = false;
+  return victim;
+}
+
+static int sd_cacheInsert(sec_t sector, const uint8_t* data, bool dirty) {
+  int idx = sd_cacheVictim();
+  if(idx >= 0) {
+    memcpy(sd_cacheEntryData(idx), data, 512);
+    entries[idx].sector = sector;
+    entries[idx].valid = true;
+    entries[idx].dirty = dirty;
+    entries[idx].lastUsed = ++useCounter;
+  }
+  return idx;
+}
+
+static inline bool sd_cacheIsSmall(sec_t numSectors) {
+  return numSectors <= (cacheSectors / 4 > 0 ? cacheSectors / 4 : 1);
+}
+
+bool sd_cacheFlush() {
+  bool success = true;
+  for(int i = 0 ; i < cacheSectors ; i++) {
+    success = sd_cacheWriteBack(i) && success;
+  }
+  return success;
+}
+
+bool sd_cacheReadSectors(sec_t sector, sec_t numSectors, void* buffer) {
+  uint8_t* dest = (uint8_t*) buffer;
+
+  if(cacheSectors == 0) {
+    return sd_readAheadRead(sector, numSectors, dest);
+  }
+
+  if(sd_cacheIsSmall(numSectors)) {
+    bool allHit = true;
+    for(sec_t i = 0 ; i < numSectors ; i++) {
+      if(sd_cacheFind(sector + i) < 0) {
+	allHit = false;
+	break;
+      }
+    }
+
+    if(allHit) {
+      for(sec_t i = 0 ; i < numSectors ; i++) {
+	int idx = sd_cacheFind(sector + i);
+	memcpy(dest + (i*512), sd_cacheEntryData(idx), 512);
+	entries[idx].lastUsed = ++useCounter;
+      }
+      stats.hits += numSectors;
+      return true;
+    }
+  }
+
+  // read the whole range in one go, then let the cache override (it may hold newer, dirty data)
+  if(!sd_readAheadRead(sector, numSectors, dest)) {
+    return false;
+  }
+
+  bool small = sd_cacheIsSmall(numSectors);
+  for(sec_t i = 0 ; i < numSectors ; i++) {
+    int idx = sd_cacheFind(sector + i);
+    if(idx >= 0) {
+      memcpy(dest + (i*512), sd_cacheEntryData(idx), 512);
+      entries[idx].lastUsed = ++useCounter;
+      stats.hits++;
+    } else {
+      stats.misses++;
+      if(small) {
+	sd_cacheInsert(sector + i, dest + (i*512), false);
+      }
+    }
+  }
+  return true;
+}
+
+bool sd_cacheWriteSectors(sec_t sector, sec_t numSectors, const void* buffer) {
+  const uint8_t* src = (const uint8_t*) buffer;
+
+  if(cacheSectors == 0) {
+    return sd_readAheadWrite(sector, numSectors, src);
+  }
+
+  if(sd_cacheIsSmall(numSectors)) {
+    for(sec_t i = 0 ; i < numSectors ; i++) {
+      int idx = sd_cacheFind(sector + i);
+      if(idx >= 0) {
+	memcpy(sd_cacheEntryData(idx), src + (i*512), 512);
+	entries[idx].dirty = true;
+	entries[idx].lastUsed = ++useCounter;
+      } else if(sd_cacheInsert(sector + i, src + (i*512), true) < 0) {
+	return false;
+      }
+    }
+    return true;
+  }
+
+  if(!sd_readAheadWrite(sector, numSectors, src)) {
+    return false;
+  }
+
+  // keep any cached copies in step with what is now on the card
+  for(sec_t i = 0 ; i < numSectors ; i++) {
+    int idx = sd_cacheFind(sector + i);
+    if(idx >= 0) {
+      memcpy(sd_cacheEntryData(idx), src + (i*512), 512);
+      entries[idx].dirty = false;
+    }
+  }
+  return true;
+}
+
+int sdCacheInit(int sectors) {
+  if(!sd_cacheFlush()) {
+    return 1;
+  }
+
+  free(entries);
+  free(cacheData);
+  entries = NULL;
+  cacheData = NULL;
+  cacheSectors = 0;
+  useCounter = 0;
+  sdCacheResetStats();
+
+  if(sectors <= 0) {
+    return 0;
+  }
+
+  entries = (CacheEntry*) calloc(sectors, sizeof(CacheEntry));
+  cacheData = (uint8_t*) memalign(32, sectors*512);
+  if(entries == NULL || cacheData == NULL) {
+    free(entries);
+    free(cacheData);
+    entries = NULL;
+    cacheData = NULL;
+    return 2;
+  }
+
+  cacheSectors = sectors;
+  return 0;
+}
+
+int sdCacheFlush() {
+  return sd_cacheFlush() ? 0 : 1;
+}
+
+void sdCacheGetStats(SdCacheStats* out) {
+  *out = stats;
+}
+
+void sdCacheResetStats() {
+  memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,174 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+/*
+  The cache is a whole number of tiles, at least one more than the view in each direction, and map tile (col, row)
+  always goes in cache slot (col % cacheCols, row % cacheRows). Any view's worth of tiles then has a slot each, and
+  scrolling only has to draw the tiles which weren't in the last view - they land in the slots of tiles which have
+  gone out of view. The view is copied out of the cache in up to four pieces where it wraps around.
+
+  Changed tiles are recorded into the list as they happen and run before the next draw. There are never more of
+  them than the cache holds, beyond that the whole cache is redrawn, so a draw always fits in the list.
+*/
+
+static inline int tilemap_max(int a, int b) {
+  return a > b ? a : b;
+}
+
+static inline int tilemap_min(int a, int b) {
+  return a < b ? a : b;
+}
+
+// make the list ready to record into, waiting for the last draw if it's still running
+static void tilemap_open(TileMap* map) {
+  if(map->submitted) {
+    rgbListClear(&map->list);
+    map->submitted = false;
+  }
+}
+
+static void tilemap_drawTile(TileMap* map, int col, int row) {
+  int tile = map->tiles[row*map->mapW + col];
+  int perRow = map->tileset->w / map->tileW;
+  Rect src = {(tile % perRow)*map->tileW, (tile / perRow)*map->tileH, map->tileW, map->tileH};
+  rgbListBlit(&map->list, map->tileset, &src, &map->cache, (col % map->cacheCols)*map->tileW, (row % map->cacheRows)*map->tileH, false);
+}
+
+static void tilemap_drawTiles(TileMap* map, int firstCol, int firstRow, int lastCol, int lastRow) {
+  for(int row = firstRow ; row <= lastRow ; row++) {
+    for(int col = firstCol ; col <= lastCol ; col++) {
+      tilemap_drawTile(map, col, row);
+    }
+  }
+}
+
+static inline void tilemap_copy(TileMap* map, Graphic* dest, int sx, int sy, int w, int h, int x, int y) {
+  if(w > 0 && h > 0) {
+    rgbListBlit(&map->list, &map->cache, &((Rect){sx, sy, w, h}), dest, x, y, false);
+  }
+}
+
+int tileMapInit(TileMap* map, Graphic* tileset, int tileW, int tileH, uint16_t* tiles, int mapW, int mapH, int viewW, int viewH) {
+  if(tileW <= 0 || tileH <= 0 || tileset->w < tileW || viewW <= 0 || viewH <= 0
+     || mapW*tileW < viewW || mapH*tileH < viewH
+     || (tileset->format != P8BPP && tileset->format != RGB565)) {
+    return 1;
+  }
+
+  map->tileset = tileset;
+  map->tileW = tileW;
+  map->tileH = tileH;
+  map->tiles = tiles;
+  map->mapW = mapW;
+  map->mapH = mapH;
+  map->viewW = viewW;
+  map->viewH = viewH;
+  map->scrollX = 0;
+  map->scrollY = 0;
+  map->cacheCols = (viewW + tileW - 1)/tileW + 1;
+  map->cacheRows = (viewH + tileH - 1)/tileH + 1;
+  map->cacheValid = false;
+  map->submitted = false;
+
+  map->cache.w = map->cacheCols*tileW;
+  map->cache.h = map->cacheRows*tileH;
+  map->cache.format = tileset->format;
+  uint32_t cacheBytes = map->cache.w*map->cache.h*(tileset->format == RGB565 ? 2 : 1);
+  void* cache = malloc(cacheBytes);
+  if(cache == NULL) {
+    return 1;
+  }
+  // only the accelerator writes the cache, so no dirty lines may be left to be written back over it
+  cacheCleanInvalidateRange(cache, cacheBytes);
+  map->cache.data = cache;
+
+  if(rgbListInit(&map->list, 2*map->cacheCols*map->cacheRows + 4)) {
+    free(cache);
+    map->cache.data = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+void tileMapFree(TileMap* map) {
+  tileMapWait(map);
+  rgbListFree(&map->list);
+  free((void*)map->cache.data);
+  map->cache.data = NULL;
+}
+
+void tileMapScroll(TileMap* map, int x, int y) {
+  map->scrollX = tilemap_max(0, tilemap_min(x, map->mapW*map->tileW - map->viewW));
+  map->scrollY = tilemap_max(0, tilemap_min(y, map->mapH*map->tileH - map->viewH));
+}
+
+void tileMapSetTile(TileMap* map, int col, int row, uint16_t tile) {
+  map->tiles[row*map->mapW + col] = tile;
+  if(!map->cacheValid
+     || col < map->cachedCol || col > map->cachedLastCol || row < map->cachedRow || row > map->cachedLastRow) {
+    return;
+  }
+
+  tilemap_open(map);
+  if(map->list.count >= map->cacheCols*map->cacheRows) {
+    tileMapInvalidate(map);
+  } else {
+    tilemap_drawTile(map, col, row);
+  }
+}
+
+void tileMapInvalidate(TileMap* map) {
+  tilemap_open(map);
+  rgbListClear(&map->list); // anything recorded is about to be drawn again anyway
+  map->cacheValid = false;
+}
+
+void tileMapDraw(TileMap* map, Graphic* dest, int x, int y) {
+  tilemap_open(map);
+
+  int firstCol = map->scrollX / map->tileW;
+  int firstRow = map->scrollY / map->tileH;
+  int lastCol = (map->scrollX + map->viewW - 1) / map->tileW;
+  int lastRow = (map->scrollY + map->viewH - 1) / map->tileH;
+
+  // tiles still cached from the last draw
+  int keptCol = tilemap_max(firstCol, map->cachedCol);
+  int keptRow = tilemap_max(firstRow, map->cachedRow);
+  int keptLastCol = tilemap_min(lastCol, map->cachedLastCol);
+  int keptLastRow = tilemap_min(lastRow, map->cachedLastRow);
+
+  if(!map->cacheValid || keptCol > keptLastCol || keptRow > keptLastRow) {
+    tilemap_drawTiles(map, firstCol, firstRow, lastCol, lastRow);
+  } else {
+    tilemap_drawTiles(map, firstCol, firstRow, lastCol, keptRow - 1);
+    tilemap_drawTiles(map, firstCol, keptLastRow + 1, lastCol, lastRow);
+    tilemap_drawTiles(map, firstCol, keptRow, keptCol - 1, keptLastRow);
+    tilemap_drawTiles(map, keptLastCol + 1, keptRow, lastCol, keptLastRow);
+  }
+
+  map->cachedCol = firstCol;
+  map->cachedRow = firstRow;
+  map->cachedLastCol = lastCol;
+  map->cachedLastRow = lastRow;
+  map->cacheValid = true;
+
+  int sx = map->scrollX % map->cache.w;
+  int sy = map->scrollY % map->cache.h;
+  int w = tilemap_min(map->viewW, map->cache.w - sx);
+  int h = tilemap_min(map->viewH, map->cache.h - sy);
+  tilemap_copy(map, dest, sx, sy, w, h, x, y);
+  tilemap_copy(map, dest, 0, sy, map->viewW - w, h, x + w, y);
+  tilemap_copy(map, dest, sx, 0, w, map->viewH - h, x, y + h);
+  tilemap_copy(map, dest, 0, 0, map->viewW - w, map->viewH - h, x + w, y + h);
+
+  rgbListSubmit(&map->list);
+  map->submitted = true;
+}
+
+void tileMapWait(TileMap* map) {
+  if(map->submitted) {
+    rgbListWait(&map->list);
+  }
+}
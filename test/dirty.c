@@ -0,0 +1,105 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stdlib.h>
+#include "host.h"
+
+static bool overlaps(const Rect* a, const Rect* b) {
+  return a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+static bool covers(const DirtyRegion* region, int x, int y) {
+  for(int i = 0 ; i < region->count ; i++) {
+    const Rect* r = &region->rects[i];
+    if(x >= r->x && x < r->x + r->w && y >= r->y && y < r->y + r->h) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// every pixel added stays covered and the rectangles never overlap, however many are added
+static void checkCoalescing() {
+  DirtyRegion region;
+  Rect added[200];
+  dirtyClear(&region);
+  srand(1);
+  for(int n = 0 ; n < 200 ; n++) {
+    added[n] = (Rect){rand() % 300, rand() % 220, 1 + rand() % 20, 1 + rand() % 20};
+    dirtyAdd(&region, &added[n]);
+    CHECK(region.count <= DIRTY_MAX_RECTS);
+    for(int i = 0 ; i < region.count ; i++) {
+      for(int j = i + 1 ; j < region.count ; j++) {
+	CHECK(!overlaps(&region.rects[i], &region.rects[j]));
+      }
+    }
+  }
+  for(int n = 0 ; n < 200 ; n++) {
+    CHECK(covers(&region, added[n].x, added[n].y));
+    CHECK(covers(&region, added[n].x + added[n].w - 1, added[n].y + added[n].h - 1));
+  }
+
+  // side by side rectangles merge for free
+  Rect left = {0, 0, 10, 10};
+  Rect right = {10, 0, 10, 10};
+  dirtyClear(&region);
+  dirtyAdd(&region, &left);
+  dirtyAdd(&region, &right);
+  CHECK_EQ(region.count, 1);
+  CHECK_EQ(region.rects[0].w, 20);
+}
+
+static void checkTracker() {
+  int buffers[2];
+  void* pointers[] = {&buffers[0], &buffers[1]};
+  DirtyTracker tracker;
+  CHECK_EQ(dirtyTrackerInit(&tracker, pointers, 2, 320, 240), 0);
+
+  // both buffers start out entirely dirty
+  DirtyRegion* region = dirtyTrackerGet(&tracker, pointers[0]);
+  CHECK_EQ(region->count, 1);
+  CHECK_EQ(region->rects[0].w, 320);
+  CHECK_EQ(region->rects[0].h, 240);
+  dirtyTrackerDone(&tracker, pointers[0]);
+  CHECK_EQ(dirtyTrackerGet(&tracker, pointers[0])->count, 0);
+  dirtyTrackerDone(&tracker, pointers[0]);
+
+  // changes are clipped to the screen and go to every buffer
+  Rect change = {300, 230, 50, 50};
+  dirtyTrackerAdd(&tracker, &change);
+  region = dirtyTrackerGet(&tracker, pointers[0]);
+  CHECK_EQ(region->count, 1);
+  CHECK_EQ(region->rects[0].w, 20);
+  CHECK_EQ(region->rects[0].h, 10);
+
+  // a change made while a buffer is being redrawn is kept for its next frame
+  Rect late = {0, 0, 8, 8};
+  dirtyTrackerAdd(&tracker, &late);
+  dirtyTrackerDone(&tracker, pointers[0]);
+  region = dirtyTrackerGet(&tracker, pointers[0]);
+  CHECK_EQ(region->count, 1);
+  CHECK(covers(region, 0, 0));
+  CHECK(!covers(region, 300, 230));
+  dirtyTrackerDone(&tracker, pointers[0]);
+
+  // the other buffer still has both changes
+  region = dirtyTrackerGet(&tracker, pointers[1]);
+  CHECK(covers(region, 0, 0));
+  CHECK(covers(region, 300, 230));
+
+  // a region handed out again without being finished keeps what it had
+  dirtyTrackerAdd(&tracker, &late);
+  region = dirtyTrackerGet(&tracker, pointers[1]);
+  CHECK(covers(region, 300, 230));
+
+  CHECK(dirtyTrackerGet(&tracker, NULL) == NULL);
+}
+
+int main() {
+  checkCoalescing();
+  checkTracker();
+  if(failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
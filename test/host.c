@@ -0,0 +1,56 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include "host.h"
+
+int failures = 0;
+int poolFrees = 0;
+void* lastPoolFree = NULL;
+
+bool arm940IsThis() {
+  return false;
+}
+
+uint32_t irqSuspendAll() {
+  return 0;
+}
+
+void irqResume(uint32_t state) {
+}
+
+/*
+  The library keeps pointers in 32-bit registers and descriptors, so memory handed to it has to be below 4G. This
+  replaces the C library's memalign with a simple pool. Pool memory is never reused, freeing it is only counted so
+  checks can see what the library gives back.
+*/
+#define POOL_SIZE (16 << 20)
+
+static uint8_t* pool = NULL;
+static uintptr_t poolUsed = 0;
+
+void* memalign(size_t align, size_t size) {
+  if(pool == NULL) {
+    pool = mmap(NULL, POOL_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if(pool == MAP_FAILED) {
+      return NULL;
+    }
+  }
+
+  uintptr_t start = (((uintptr_t)pool + poolUsed + align - 1) & ~(uintptr_t)(align - 1)) - (uintptr_t)pool;
+  if(start + size > POOL_SIZE) {
+    return NULL;
+  }
+  poolUsed = start + size;
+  return pool + start;
+}
+
+extern void __libc_free(void* ptr);
+
+void free(void* ptr) {
+  if(pool != NULL && (uint8_t*)ptr >= pool && (uint8_t*)ptr < pool + POOL_SIZE) {
+    poolFrees++;
+    lastPoolFree = ptr;
+  } else {
+    __libc_free(ptr);
+  }
+}
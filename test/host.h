@@ -0,0 +1,25 @@
+#ifndef __ORCUS_TEST_HOST_H__
+#define __ORCUS_TEST_HOST_H__
+
+#include <stdio.h>
+
+extern int failures;
+extern int poolFrees;
+extern void* lastPoolFree;
+
+#define CHECK(cond) do {						\
+    if(!(cond)) {							\
+      printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond);	\
+      failures++;							\
+    }									\
+  } while(0)
+
+#define CHECK_EQ(actual, expected) do {					\
+    unsigned long long _a = (actual), _e = (expected);			\
+    if(_a != _e) {							\
+      printf("%s:%d: %s is 0x%llx, expected 0x%llx\n", __FILE__, __LINE__, #actual, _a, _e); \
+      failures++;							\
+    }									\
+  } while(0)
+
+#endif
@@ -0,0 +1,148 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include "host.h"
+
+/*
+  Built for the host this is the C version of the mixer, which the ARM loops are meant to match. Each check renders
+  from voice 0 (and voice 1 where two are needed) and stops them afterwards so the next check starts silent.
+*/
+#define FRAMES 600 // more than two chunks, so voices carry on across chunk boundaries
+
+static uint32_t out[FRAMES];
+
+static int16_t left(int frame) {
+  return out[frame] & 0xFFFF;
+}
+
+static int16_t right(int frame) {
+  return out[frame] >> 16;
+}
+
+static void stopAll() {
+  for(int i = 0 ; i < MIXER_VOICES ; i++) {
+    mixerStop(i);
+    mixerSetVolume(i, MIXER_UNITY, MIXER_CENTRE);
+    mixerSetRate(i, 44100);
+  }
+}
+
+static void checkSilence() {
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES ; i++) {
+    CHECK_EQ(out[i], 0);
+  }
+}
+
+static void checkPcm16() {
+  static int16_t data[FRAMES];
+  for(int i = 0 ; i < FRAMES ; i++) {
+    data[i] = i*37 - 10000;
+  }
+  mixerPlay(0, data, 500, MIXER_PCM16, false);
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < 500 ; i++) {
+    CHECK_EQ(left(i), data[i]);
+    CHECK_EQ(right(i), data[i]);
+  }
+  // stops at the end of the data rather than running on
+  for(int i = 500 ; i < FRAMES ; i++) {
+    CHECK_EQ(out[i], 0);
+  }
+  CHECK(!mixerIsPlaying(0));
+  stopAll();
+}
+
+static void checkPcm8Looped() {
+  static const int8_t data[] = { 100, -100, 127, -128, 0 };
+  mixerPlay(0, data, 5, MIXER_PCM8, true);
+  mixerSetVolume(0, MIXER_UNITY, 0); // hard left
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES ; i++) {
+    CHECK_EQ(left(i), data[i % 5] << 8);
+    CHECK_EQ(right(i), 0);
+  }
+  CHECK(mixerIsPlaying(0));
+  stopAll();
+}
+
+// voices which add up past 16 bits clip at the limits rather than wrapping around
+static void checkSaturation() {
+  static int16_t high[FRAMES], low[FRAMES];
+  for(int i = 0 ; i < FRAMES ; i++) {
+    high[i] = 30000;
+    low[i] = -30000;
+  }
+
+  mixerPlay(0, high, FRAMES, MIXER_PCM16, false);
+  mixerPlay(1, high, FRAMES, MIXER_PCM16, false);
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES ; i++) {
+    CHECK_EQ(left(i), 32767);
+    CHECK_EQ(right(i), 32767);
+  }
+  stopAll();
+
+  mixerPlay(0, low, FRAMES, MIXER_PCM16, false);
+  mixerPlay(1, low, FRAMES, MIXER_PCM16, false);
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES ; i++) {
+    CHECK_EQ(left(i), -32768);
+    CHECK_EQ(right(i), -32768);
+  }
+  stopAll();
+
+  // amplifying a single voice clips as well, on one side only
+  static const int8_t data[] = { 127, -128 };
+  mixerPlay(0, data, 2, MIXER_PCM8, true);
+  mixerSetVolume(0, 2*MIXER_UNITY, 256);
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES ; i++) {
+    CHECK_EQ(left(i), 0);
+    CHECK_EQ(right(i), i % 2 == 0 ? 32767 : -32768);
+  }
+  stopAll();
+}
+
+static void checkResampling() {
+  static int16_t ramp[FRAMES];
+  for(int i = 0 ; i < FRAMES ; i++) {
+    ramp[i] = i*50;
+  }
+
+  // half the output rate plays each sample twice, interpolating halfway between them in between
+  mixerPlay(0, ramp, FRAMES, MIXER_PCM16, false);
+  mixerSetRate(0, 22050);
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES ; i++) {
+    CHECK_EQ(left(i), (i/2)*50 + (i % 2)*25);
+  }
+  CHECK(mixerIsPlaying(0));
+  stopAll();
+
+  // twice the output rate skips every other sample and runs out halfway through
+  mixerPlay(0, ramp, FRAMES, MIXER_PCM16, false);
+  mixerSetRate(0, 88200);
+  mixerRender(out, sizeof(out));
+  for(int i = 0 ; i < FRAMES/2 ; i++) {
+    CHECK_EQ(left(i), i*100);
+  }
+  for(int i = FRAMES/2 ; i < FRAMES ; i++) {
+    CHECK_EQ(out[i], 0);
+  }
+  CHECK(!mixerIsPlaying(0));
+  stopAll();
+}
+
+int main() {
+  checkSilence();
+  checkPcm16();
+  checkPcm8Looped();
+  checkSaturation();
+  checkResampling();
+  checkSilence();
+  if(failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,208 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stdlib.h>
+#include "host.h"
+
+/*
+  Descriptors are worked out bit by bit here rather than with the cachemmu.h macros, so a mistake in a macro shows
+  up as well. Everything is mapped read-write with user access (AP 01) in domain 0.
+*/
+static uint32_t section(uint32_t address, bool cacheable, bool buffered) {
+  return (address & 0xFFF00000) | (1 << 10) | (1 << 4) | (cacheable << 3) | (buffered << 2) | 0x2;
+}
+
+static uint32_t sectionFor(uint32_t address, MemoryAttributes attributes) {
+  return section(address, attributes == MEM_WRITE_THROUGH || attributes == MEM_WRITE_BACK,
+		 attributes == MEM_BUFFERED || attributes == MEM_WRITE_BACK);
+}
+
+static uint32_t mmu_cacheableBit(MemoryAttributes attributes) {
+  return attributes == MEM_WRITE_THROUGH || attributes == MEM_WRITE_BACK;
+}
+
+static uint32_t mmu_bufferedBit(MemoryAttributes attributes) {
+  return attributes == MEM_BUFFERED || attributes == MEM_WRITE_BACK;
+}
+
+static void checkDefaultTable() {
+  uint32_t* l1 = mmuNewL1Table();
+  CHECK(l1 != NULL);
+  CHECK_EQ((uintptr_t)l1 & (MMU_L1_ALIGN - 1), 0);
+  for(uint32_t i = 0 ; i < 4096 ; i++) {
+    CHECK_EQ(l1[i], sectionFor(i*SZ_1M, i < 64 ? MEM_WRITE_BACK : MEM_UNCACHED));
+  }
+}
+
+static void checkRegions() {
+  MemoryRegion regions[] = {
+			    { .address = 0x0, .size = 64*SZ_1M, .attributes = MEM_WRITE_BACK },
+			    // partial sections at each end are rounded out to whole sections
+			    { .address = 0x3080000, .size = 0x100000, .attributes = MEM_BUFFERED },
+			    { .address = 0x4000000, .size = 0x1, .attributes = MEM_WRITE_THROUGH },
+			    // up to the top of the address space, without wrapping around to section 0
+			    { .address = 0xFFF00000, .size = SZ_1M, .attributes = MEM_WRITE_THROUGH }
+  };
+  uint32_t* l1 = mmuNewL1TableFromRegions(regions, 4);
+  CHECK(l1 != NULL);
+
+  for(uint32_t i = 0 ; i < 4096 ; i++) {
+    MemoryAttributes expected = MEM_UNCACHED;
+    if(i < 48) {
+      expected = MEM_WRITE_BACK;
+    } else if(i < 50) {
+      expected = MEM_BUFFERED; // later regions win where they overlap
+    } else if(i < 64) {
+      expected = MEM_WRITE_BACK;
+    } else if(i == 64 || i == 4095) {
+      expected = MEM_WRITE_THROUGH;
+    }
+    CHECK_EQ(l1[i], sectionFor(i*SZ_1M, expected));
+  }
+
+  // changing an existing table only touches the sections in the regions
+  MemoryRegion framebuffer = { .address = 0x3000000, .size = SZ_1M, .attributes = MEM_UNCACHED };
+  mmuSetRegions(l1, &framebuffer, 1);
+  CHECK_EQ(l1[47], sectionFor(47*SZ_1M, MEM_WRITE_BACK));
+  CHECK_EQ(l1[48], sectionFor(48*SZ_1M, MEM_UNCACHED));
+  CHECK_EQ(l1[49], sectionFor(49*SZ_1M, MEM_BUFFERED));
+}
+
+/*
+  Walk the tables the way the MMU does, checking that repeated entries for large and small pages all match. Returns
+  the physical address, or -1 for a fault, with the cache and buffer bits in attributes.
+*/
+#define WALK_FAULT 0xFFFFFFFFFFFFull
+
+static uint64_t walk(uint32_t* l1, uint32_t va, uint32_t* attributes) {
+  uint32_t d = l1[va >> 20];
+  uint32_t* table;
+  uint32_t e;
+
+  switch(d & 0x3) {
+  case 0x2:
+    *attributes = d & 0xC;
+    return (d & 0xFFF00000) | (va & 0xFFFFF);
+  case 0x1:
+    table = (uint32_t*)(uintptr_t)(d & 0xFFFFFC00);
+    e = table[(va >> 12) & 0xFF];
+    *attributes = e & 0xC;
+    if((e & 0x3) == 0x1) {
+      for(uint32_t i = 0 ; i < 16 ; i++) {
+	CHECK_EQ(table[((va >> 12) & 0xF0) + i], e);
+      }
+      return (e & 0xFFFF0000) | (va & 0xFFFF);
+    }
+    CHECK((e & 0x3) != 0x3); // no tiny pages in coarse tables
+    return (e & 0x3) == 0x2 ? (e & 0xFFFFF000) | (va & 0xFFF) : WALK_FAULT;
+  case 0x3:
+    table = (uint32_t*)(uintptr_t)(d & 0xFFFFF000);
+    e = table[(va >> 10) & 0x3FF];
+    *attributes = e & 0xC;
+    if((e & 0x3) == 0x1) {
+      for(uint32_t i = 0 ; i < 64 ; i++) {
+	CHECK_EQ(table[((va >> 10) & 0x3C0) + i], e);
+      }
+      return (e & 0xFFFF0000) | (va & 0xFFFF);
+    } else if((e & 0x3) == 0x2) {
+      for(uint32_t i = 0 ; i < 4 ; i++) {
+	CHECK_EQ(table[((va >> 10) & 0x3FC) + i], e);
+      }
+      return (e & 0xFFFFF000) | (va & 0xFFF);
+    }
+    return (e & 0x3) == 0x3 ? (e & 0xFFFFFC00) | (va & 0x3FF) : WALK_FAULT;
+  default:
+    return WALK_FAULT;
+  }
+}
+
+// what each 1K page of the first few sections should map to
+#define MODEL_PAGES (5*SZ_1M/SZ_1K)
+
+static uint64_t modelAddress[MODEL_PAGES];
+static uint32_t modelAttributes[MODEL_PAGES];
+
+static void checkAgainstModel(uint32_t* l1) {
+  for(uint32_t page = 0 ; page < MODEL_PAGES ; page++) {
+    uint32_t attributes = 0;
+    uint64_t address = walk(l1, page*SZ_1K + 0x3F0, &attributes);
+    if(address != (modelAddress[page] == WALK_FAULT ? WALK_FAULT : modelAddress[page] + 0x3F0)) {
+      printf("page 0x%x maps to 0x%llx, expected 0x%llx\n", page*SZ_1K, (unsigned long long)address,
+	     (unsigned long long)modelAddress[page]);
+      failures++;
+      return;
+    }
+    if(address != WALK_FAULT && attributes != modelAttributes[page]) {
+      printf("page 0x%x has attributes 0x%x, expected 0x%x\n", page*SZ_1K, attributes, modelAttributes[page]);
+      failures++;
+      return;
+    }
+  }
+}
+
+// map and unmap ranges of every alignment and size, which ends up with sections, coarse and fine tables side by side
+static void checkPages() {
+  uint32_t* l1 = mmuNewL1Table();
+  for(uint32_t page = 0 ; page < MODEL_PAGES ; page++) {
+    modelAddress[page] = page*SZ_1K;
+    modelAttributes[page] = 0xC;
+  }
+
+  CHECK(mmuMapPages(l1, 0x1000, 0x2000, 0x200, MEM_WRITE_BACK) != 0);
+
+  srand(1);
+  uint32_t units[] = { SZ_1K, SZ_4K, SZ_64K };
+  for(int n = 0 ; n < 300 ; n++) {
+    uint32_t unit = units[rand() % (n < 100 ? 2 : 3)]; // start with small ranges so the sections stay part mapped
+    uint32_t virtualAddr = (rand() % (3*SZ_1M/unit)) * unit;
+    uint32_t physicalAddr = 0x8000000 + (rand() % (SZ_1M/unit)) * unit;
+    uint32_t size = (1 + rand() % 20) * unit;
+    MemoryAttributes attributes = rand() % 4;
+    bool map = rand() % 4 != 0;
+
+    int result = map ? mmuMapPages(l1, virtualAddr, physicalAddr, size, attributes) : mmuUnmapPages(l1, virtualAddr, size);
+    CHECK_EQ(result, 0);
+    for(uint32_t offset = 0 ; offset < size ; offset += SZ_1K) {
+      uint32_t page = (virtualAddr + offset) / SZ_1K;
+      modelAddress[page] = map ? physicalAddr + offset : WALK_FAULT;
+      modelAttributes[page] = (mmu_cacheableBit(attributes) << 3) | (mmu_bufferedBit(attributes) << 2);
+    }
+    checkAgainstModel(l1);
+    if(failures > 0) {
+      printf("after %s 0x%x -> 0x%x size 0x%x\n", map ? "mapping" : "unmapping", virtualAddr, physicalAddr, size);
+      return;
+    }
+  }
+
+  // ranges end before the sixth section, which was never touched
+  CHECK_EQ(l1[5], sectionFor(5*SZ_1M, MEM_WRITE_BACK));
+}
+
+// a coarse table copied into a fine one to make room for a tiny page is given back
+static void checkCoarseTableFreed() {
+  uint32_t* l1 = mmuNewL1Table();
+  CHECK_EQ(mmuMapPages(l1, 0x100000, 0x8000000, SZ_4K, MEM_UNCACHED), 0);
+  CHECK_EQ(l1[1] & 0x3, 0x1);
+  void* coarse = (void*)(uintptr_t)(l1[1] & 0xFFFFFC00);
+
+  int frees = poolFrees;
+  CHECK_EQ(mmuMapPages(l1, 0x101000, 0x8001000, SZ_1K, MEM_UNCACHED), 0);
+  CHECK_EQ(l1[1] & 0x3, 0x3);
+  CHECK_EQ(poolFrees, frees + 1);
+  CHECK(lastPoolFree == coarse);
+
+  // further tiny pages go into the fine table without freeing anything
+  CHECK_EQ(mmuMapPages(l1, 0x102000, 0x8002000, SZ_1K, MEM_UNCACHED), 0);
+  CHECK_EQ(poolFrees, frees + 1);
+}
+
+int main() {
+  checkDefaultTable();
+  checkRegions();
+  checkPages();
+  checkCoarseTableFreed();
+  if(failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
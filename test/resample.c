@@ -0,0 +1,103 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stdlib.h>
+#include "host.h"
+
+/*
+  Output is checked against positions worked out in 64 bits from the start of the stream, for a stream fed in one
+  block longer than 16 bits of frames and for the same stream fed in blocks of random sizes.
+*/
+#define INPUT_FRAMES 200000
+#define OUTPUT_FRAMES 400000
+
+static int16_t input[INPUT_FRAMES*2];
+static int16_t output[OUTPUT_FRAMES*2];
+
+static int16_t inputSample(int64_t frame, int channel) {
+  return frame < 0 ? 0 : input[frame*2 + channel];
+}
+
+static int16_t expected(uint32_t step, int64_t n, int channel) {
+  uint64_t pos = 0x10000 + (uint64_t)n*step;
+  int64_t frame = (int64_t)(pos >> 16) - 1;
+  int32_t a = inputSample(frame, channel);
+  int32_t b = inputSample(frame + 1, channel);
+  return a + (((b - a) * (int32_t)((pos & 0xFFFF) >> 1)) >> 15);
+}
+
+// how many output frames the input is good for, each needing the input frame after its position
+static int expectedFrames(uint32_t step) {
+  uint64_t last = ((uint64_t)INPUT_FRAMES) << 16;
+  return (last - 0x10000 + step - 1) / step;
+}
+
+static void checkOutput(uint32_t step, int produced, const char* how) {
+  int wanted = expectedFrames(step);
+  wanted = wanted > OUTPUT_FRAMES ? OUTPUT_FRAMES : wanted;
+  if(produced != wanted) {
+    printf("step 0x%x %s: %d frames, expected %d\n", step, how, produced, wanted);
+    failures++;
+    return;
+  }
+  for(int n = 0 ; n < produced ; n++) {
+    for(int channel = 0 ; channel < 2 ; channel++) {
+      if(output[n*2 + channel] != expected(step, n, channel)) {
+	printf("step 0x%x %s: frame %d is %d, expected %d\n", step, how, n, output[n*2 + channel],
+	       expected(step, n, channel));
+	failures++;
+	return;
+      }
+    }
+  }
+}
+
+static void checkRates(int inputRate, int outputRate) {
+  Resampler resampler;
+  CHECK_EQ(resamplerInit(&resampler, inputRate, outputRate), 0);
+  uint32_t step = resampler.step;
+
+  int used;
+  int produced = resamplerProcess(&resampler, input, INPUT_FRAMES, output, OUTPUT_FRAMES, &used);
+  checkOutput(step, produced, "in one block");
+
+  resamplerInit(&resampler, inputRate, outputRate);
+  int consumed = 0;
+  produced = 0;
+  while(produced < OUTPUT_FRAMES) {
+    int inputFrames = rand() % 300;
+    inputFrames = inputFrames > INPUT_FRAMES - consumed ? INPUT_FRAMES - consumed : inputFrames;
+    int outputFrames = rand() % 300;
+    outputFrames = outputFrames > OUTPUT_FRAMES - produced ? OUTPUT_FRAMES - produced : outputFrames;
+    int n = resamplerProcess(&resampler, input + consumed*2, inputFrames, output + produced*2, outputFrames, &used);
+    CHECK(used <= inputFrames);
+    consumed += used;
+    produced += n;
+    if(consumed == INPUT_FRAMES && n == 0 && outputFrames > 0) {
+      break;
+    }
+  }
+  checkOutput(step, produced, "in small blocks");
+}
+
+int main() {
+  for(int i = 0 ; i < INPUT_FRAMES*2 ; i++) {
+    input[i] = rand();
+  }
+
+  Resampler resampler;
+  CHECK(resamplerInit(&resampler, 0, 44100) != 0);
+  CHECK(resamplerInit(&resampler, 44100, 0) != 0);
+  CHECK(resamplerInit(&resampler, 32768*100, 100) == 0);
+  CHECK(resamplerInit(&resampler, 32768*100 + 1, 100) != 0);
+
+  checkRates(22050, 44100);
+  checkRates(44100, 22050);
+  checkRates(32000, 44100);
+  checkRates(11025, 48000);
+  checkRates(48000, 44100);
+  if(failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,183 @@
+#include <gp2xregs.h>
+#include <orcus.h>
+#include <stdlib.h>
+#include "host.h"
+
+/*
+  The raster list is replaced by one which copies pixels in software when submitted, checking every blit stays
+  within its source and destination. Each frame the view is compared against the map drawn straight from the tile
+  set, so a tile the cache should have redrawn and didn't shows up.
+*/
+typedef struct {
+  Graphic* src;
+  Rect srcRect;
+  Graphic* dest;
+  int x, y;
+} Blit;
+
+static int listHighWater = 0;
+static int blits = 0;
+
+int rgbListInit(RasterList* list, int capacity) {
+  list->commands = malloc(capacity*sizeof(Blit));
+  list->capacity = capacity;
+  list->count = 0;
+  return list->commands == NULL;
+}
+
+void rgbListFree(RasterList* list) {
+  free(list->commands);
+}
+
+void rgbListClear(RasterList* list) {
+  list->count = 0;
+}
+
+int rgbListBlit(RasterList* list, Graphic* src, Rect* srcRect, Graphic* dest, int x, int y, bool enableTransparency) {
+  CHECK(list->count < list->capacity);
+  if(list->count >= list->capacity) {
+    return 1;
+  }
+  ((Blit*)list->commands)[list->count++] = (Blit){src, *srcRect, dest, x, y};
+  if(list->count > listHighWater) {
+    listHighWater = list->count;
+  }
+  return 0;
+}
+
+void rgbListSubmit(RasterList* list) {
+  for(int i = 0 ; i < list->count ; i++) {
+    Blit* b = &((Blit*)list->commands)[i];
+    blits++;
+    if(b->srcRect.x < 0 || b->srcRect.y < 0 || b->srcRect.x + b->srcRect.w > b->src->w
+       || b->srcRect.y + b->srcRect.h > b->src->h
+       || b->x < 0 || b->y < 0 || b->x + b->srcRect.w > b->dest->w || b->y + b->srcRect.h > b->dest->h) {
+      printf("blit %d,%d %dx%d to %d,%d is out of bounds\n", b->srcRect.x, b->srcRect.y, b->srcRect.w, b->srcRect.h,
+	     b->x, b->y);
+      failures++;
+      continue;
+    }
+    const uint16_t* src = b->src->data;
+    uint16_t* dest = (uint16_t*)b->dest->data;
+    for(int y = 0 ; y < b->srcRect.h ; y++) {
+      for(int x = 0 ; x < b->srcRect.w ; x++) {
+	dest[(b->y + y)*b->dest->w + b->x + x] = src[(b->srcRect.y + y)*b->src->w + b->srcRect.x + x];
+      }
+    }
+  }
+}
+
+void rgbListWait(RasterList* list) {
+}
+
+void cacheCleanInvalidateRange(void* start, uint32_t bytes) {
+}
+
+#define TILE_W 16
+#define TILE_H 16
+#define SET_COLS 8
+#define SET_ROWS 4
+#define MAP_W 64
+#define MAP_H 40
+#define VIEW_W 320
+#define VIEW_H 240
+#define DEST_X 5
+#define DEST_Y 7
+
+static uint16_t tilesetPixels[SET_COLS*TILE_W*SET_ROWS*TILE_H];
+static uint16_t tiles[MAP_W*MAP_H];
+static uint16_t screen[(VIEW_W + 10)*(VIEW_H + 20)];
+
+static bool checkView(TileMap* map, Graphic* dest) {
+  for(int y = 0 ; y < VIEW_H ; y++) {
+    for(int x = 0 ; x < VIEW_W ; x++) {
+      int mx = map->scrollX + x;
+      int my = map->scrollY + y;
+      int tile = tiles[(my/TILE_H)*MAP_W + mx/TILE_W];
+      uint16_t expected = tilesetPixels[((tile/SET_COLS)*TILE_H + my%TILE_H)*SET_COLS*TILE_W
+					+ (tile%SET_COLS)*TILE_W + mx%TILE_W];
+      if(screen[(DEST_Y + y)*dest->w + DEST_X + x] != expected) {
+	printf("view at %d,%d differs at %d,%d\n", map->scrollX, map->scrollY, x, y);
+	failures++;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void checkInit(Graphic* tileset) {
+  TileMap map;
+  CHECK(tileMapInit(&map, tileset, 0, TILE_H, tiles, MAP_W, MAP_H, VIEW_W, VIEW_H) != 0);
+  CHECK(tileMapInit(&map, tileset, TILE_W, TILE_H, tiles, VIEW_W/TILE_W - 1, MAP_H, VIEW_W, VIEW_H) != 0);
+  Graphic b1 = *tileset;
+  b1.format = B1BPP;
+  CHECK(tileMapInit(&map, &b1, TILE_W, TILE_H, tiles, MAP_W, MAP_H, VIEW_W, VIEW_H) != 0);
+}
+
+// random small scrolls, jumps, tile changes and invalidates
+static void checkScrolling(Graphic* tileset, Graphic* dest) {
+  TileMap map;
+  CHECK_EQ(tileMapInit(&map, tileset, TILE_W, TILE_H, tiles, MAP_W, MAP_H, VIEW_W, VIEW_H), 0);
+
+  int x = 0, y = 0;
+  for(int frame = 0 ; frame < 3000 && failures == 0 ; frame++) {
+    int action = rand() % 10;
+    if(action < 6) {
+      x += rand() % 9 - 4;
+      y += rand() % 9 - 4;
+    } else if(action < 8) {
+      x = rand() % 2000;
+      y = rand() % 1000;
+    } else if(action < 9) {
+      int changes = rand() % 400;
+      for(int n = 0 ; n < changes ; n++) {
+	tileMapSetTile(&map, rand() % MAP_W, rand() % MAP_H, rand() % (SET_COLS*SET_ROWS));
+      }
+    } else {
+      tileMapInvalidate(&map);
+    }
+
+    tileMapScroll(&map, x, y);
+    x = map.scrollX;
+    y = map.scrollY;
+    tileMapDraw(&map, dest, DEST_X, DEST_Y);
+    tileMapWait(&map);
+    checkView(&map, dest);
+  }
+  CHECK(listHighWater <= map.list.capacity);
+
+  // a one pixel scroll within a tile only copies the view, crossing into a new column draws that column as well
+  tileMapScroll(&map, 100, 100);
+  tileMapDraw(&map, dest, DEST_X, DEST_Y);
+  tileMapScroll(&map, 101, 100);
+  blits = 0;
+  tileMapDraw(&map, dest, DEST_X, DEST_Y);
+  CHECK_EQ(blits, 4);
+  tileMapScroll(&map, 117, 100);
+  blits = 0;
+  tileMapDraw(&map, dest, DEST_X, DEST_Y);
+  CHECK_EQ(blits, 4 + (VIEW_H/TILE_H + 1));
+  checkView(&map, dest);
+
+  tileMapFree(&map);
+}
+
+int main() {
+  for(int i = 0 ; i < SET_COLS*TILE_W*SET_ROWS*TILE_H ; i++) {
+    tilesetPixels[i] = rand();
+  }
+  for(int i = 0 ; i < MAP_W*MAP_H ; i++) {
+    tiles[i] = rand() % (SET_COLS*SET_ROWS);
+  }
+  Graphic tileset = { tilesetPixels, SET_COLS*TILE_W, SET_ROWS*TILE_H, RGB565 };
+  Graphic dest = { screen, VIEW_W + 10, VIEW_H + 20, RGB565 };
+
+  checkInit(&tileset);
+  checkScrolling(&tileset, &dest);
+  if(failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}